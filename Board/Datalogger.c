@@ -28,61 +28,208 @@
 #include "main.h"
 
 uint16_t DataSetAddress;	//Points to the address in the page where the next data set goes
+uint8_t DataSetsInPage;		//Number of data sets in the current page
 uint16_t DataPageAddress;	//Points to the current page to which we are writing data
+uint32_t DataPageSequence;	//Sequence number of the current page. Each new page gets the next number.
 uint8_t BufferInUse;		//Points to the current buffer to which we are saving data
+uint16_t DataTailPage;		//The oldest page in the log
+uint32_t DataTailSequence;	//Sequence number of the oldest page
+uint8_t DataTailValid;		//Set to 1 when DataTailPage is up to date
 
-//I think these are useless
-uint8_t DataSetSizeBytes;	
-//uint8_t DataSetsPerPage;
+//Pages from ErasedStartPage up to (but not including) ErasedEndPage have been erased and can be written without the built in erase
+uint16_t ErasedStartPage;
+uint16_t ErasedEndPage;
+
+//Layout of the dataflash. The log uses the pages from 0 to DataloggerLogPages-1, the rollup rings use the rest.
+uint16_t DataloggerPageSize;
+uint16_t DataloggerLogPages;
+
+uint8_t DataSetSizeBytes;	//Stride of the data sets in a page, 0 if they are delta encoded
+uint8_t DataSetsPerPage;	//Most data sets that can go in a page
+
+#if DATALOGGER_USE_COMPRESSION == 1
+uint8_t LastDataSet[DATALOGGER_DATASET_SIZE];	//The data set that the next one is delta encoded against
+#endif
 
 uint8_t DataloggerInitalized = 0;
 
+//Write cursor checkpoint saved to EEPROM
+typedef struct
+{
+	uint16_t Page;
+	uint16_t Address;
+	uint16_t Sequence;
+	uint8_t CRC;
+} DataloggerCheckpoint;
+
+DataloggerCheckpoint EEMEM CheckpointSlots[DATALOGGER_CHECKPOINT_SLOTS];
+uint8_t CheckpointSlot;			//The next EEPROM slot to write
+uint16_t CheckpointSequence;	//Sequence number of the last checkpoint written
+
+//Summary of the data sets in a page
+typedef struct
+{
+	uint32_t FirstTime;
+	uint32_t LastTime;
+	uint16_t Min[DATALOGGER_ZONE_FIELDS];
+	uint16_t Max[DATALOGGER_ZONE_FIELDS];
+} DataloggerZoneMap;
+
+DataloggerZoneMap PageZone;		//Zone map of the current page
+
+//Location of the zone map fields in a data set
+const uint8_t ZoneFieldOffset[DATALOGGER_ZONE_FIELDS] PROGMEM = {4, 6, 8, 16};
+
+//Running totals for an hour or a day
+typedef struct
+{
+	uint32_t Time;
+	uint16_t Count;
+	int32_t Sum[DATALOGGER_ZONE_FIELDS];
+	uint16_t Min[DATALOGGER_ZONE_FIELDS];
+	uint16_t Max[DATALOGGER_ZONE_FIELDS];
+} DataloggerRollup;
+
+DataloggerRollup RollupTotals[2];	//Totals for the hour and day in progress
+uint16_t RollupRecord[2];			//The next record to write in each rollup ring
+uint16_t RollupSequence[2];			//Sequence number of the next record in each rollup ring
+
+uint16_t RollupFirstPage[2];		//First page of each rollup ring
+uint16_t RollupRecords[2];			//Number of records in each rollup ring
+uint8_t RollupsPerPage;
+const uint32_t RollupPeriod[2] PROGMEM	= {3600, 86400};	//Length of an hour and a day in seconds
+
+//Decoded page header
+typedef struct
+{
+	uint32_t Sequence;
+	uint8_t Schema;
+	uint8_t RecordSize;
+	uint8_t RecordCount;
+	uint16_t EndOfData;
+	DataloggerZoneMap Zone;
+} DataloggerPageHeader;
+
+static uint8_t Datalogger_CheckpointCRC(DataloggerCheckpoint *Checkpoint);
+static uint8_t Datalogger_VerifyCursor(uint16_t *PageNumber, uint16_t *AddressInPage, uint32_t *PageSequence);
+static uint8_t Datalogger_PageFollows(uint16_t PageNumber, uint32_t Sequence, uint16_t PagesAfter);
+static uint8_t Datalogger_ReadNextHeader(uint16_t PageNumber, DataloggerPageHeader *Header);
+static uint16_t Datalogger_FindSequence(uint32_t Sequence);
+static void Datalogger_CursorAfterPage(uint16_t NewestPage, uint16_t *PageNumber, uint16_t *AddressInPage, uint32_t *PageSequence);
+static void Datalogger_CommitPage(uint8_t Buffer, uint16_t PageNumber);
+static void Datalogger_WritePage(uint8_t Buffer, uint16_t PageNumber);
+static void Datalogger_NextPage(void);
+static void Datalogger_WriteHeader(uint8_t Buffer);
+static void Datalogger_BuildHeader(uint8_t Header[]);
+static uint8_t Datalogger_ReadPageHeader(uint16_t PageNumber, DataloggerPageHeader *Header);
+static void Datalogger_ResumePage(void);
+static uint8_t Datalogger_EncodeDataSet(uint8_t DataSet[], uint8_t Record[]);
+static uint8_t Datalogger_DecodeDataSet(uint8_t Record[], uint8_t DataSet[]);
+static uint8_t Datalogger_ReadDataSet(uint8_t Buffer, uint16_t PageNumber, uint16_t AddressInPage, DataloggerPageHeader *Header, uint8_t DataSet[]);
+static void Datalogger_UpdateZone(uint8_t DataSet[]);
+static uint32_t Datalogger_DataSetTime(uint8_t DataSet[]);
+static int32_t Datalogger_FieldValue(uint16_t RawValue, uint8_t Field);
+static uint8_t Datalogger_GetPageHeader(uint16_t PageNumber, DataloggerPageHeader *Header);
+static uint16_t Datalogger_AddPages(uint16_t PageNumber, uint16_t PagesToAdd);
+static uint16_t Datalogger_PagesBetween(uint16_t FromPage, uint16_t ToPage);
+static void Datalogger_UpdateRollups(uint8_t DataSet[]);
+static void Datalogger_SaveRollup(uint8_t Tier);
+static void Datalogger_FindRollupEnd(uint8_t Tier);
+static uint8_t Datalogger_ReadRollup(uint8_t Tier, uint16_t RecordNumber, uint8_t Record[]);
+static uint16_t Datalogger_FindTail(uint16_t HeadPage);
+static uint16_t Datalogger_GetTail(void);
+
 void Datalogger_Init(uint8_t SetupByte)
 {
 	uint16_t StartingPage;
 	uint16_t StartingLocationInPage;
+	uint32_t StartingSequence;
+	uint16_t TailPage;
+	
+	//Anything left in the buffers from before is not ours any more
+	AT45DB321D_CacheInvalidate();
 	
-	DataSetSizeBytes = DATALOGGER_DATASET_SIZE + 2;
+	//Size the log to the dataflash that is fitted. The rollup rings go at the end.
+	DataloggerPageSize = AT45DB321D_GetPageSize();
+	DataloggerLogPages = AT45DB321D_GetPageCount() - DATALOGGER_ROLLUP_HOURLY_PAGES - DATALOGGER_ROLLUP_DAILY_PAGES;
+	RollupsPerPage = DataloggerPageSize / DATALOGGER_ROLLUP_RECORD_SIZE;
+	RollupFirstPage[DATALOGGER_ROLLUP_HOURLY] = DataloggerLogPages;
+	RollupFirstPage[DATALOGGER_ROLLUP_DAILY] = DataloggerLogPages + DATALOGGER_ROLLUP_HOURLY_PAGES;
+	RollupRecords[DATALOGGER_ROLLUP_HOURLY] = DATALOGGER_ROLLUP_HOURLY_PAGES * RollupsPerPage;
+	RollupRecords[DATALOGGER_ROLLUP_DAILY] = DATALOGGER_ROLLUP_DAILY_PAGES * RollupsPerPage;
+	printf_P(PSTR("Log pages: %u of %u bytes\n"), DataloggerLogPages, DataloggerPageSize);
+	
+	#if DATALOGGER_USE_COMPRESSION == 1
+	//The record count in the page header limits the number of data sets in a page
+	DataSetSizeBytes = 0;
+	DataSetsPerPage = 0xFF;
+	printf_P(PSTR("Data sets are delta encoded\n"));
+	#else
+	DataSetSizeBytes = DATALOGGER_DATASET_SIZE;
 	#if DATALOGGER_USE_CRC == 1
 	DataSetSizeBytes++;
 	#endif
+	DataSetsPerPage = (DataloggerPageSize - DATALOGGER_PAGE_HEADER_SIZE)/DataSetSizeBytes;
 
 	printf_P(PSTR("Data set size: %u\n"), DataSetSizeBytes);
-	printf_P(PSTR("Sets per page: %u\n"), DATALOGGER_PAGE_SIZE/DataSetSizeBytes);
-
-	//printf_P(PSTR("h1: 0x%02X\n"), ((DataSetSizeBytes >> 4) | DATALOGGER_HEADER1_PREFIX) );
-	//printf_P(PSTR("h2: 0X%02X\n"), ((uint8_t)(DataSetSizeBytes << 4) | DATALOGGER_HEADER2_SUFFIX));
+	printf_P(PSTR("Sets per page: %u\n"), DataSetsPerPage);
+	#endif
 
-	//This should eventually search for preexisting data sets, but for now, initalize to zero
 	if((SetupByte & DATALOGGER_INIT_APPEND) == DATALOGGER_INIT_APPEND)
 	{
-		Datalogger_FindLastDataSet(&StartingPage, &StartingLocationInPage);
-		if((StartingPage > 0x1FFF) && (StartingLocationInPage > 0x1FFF))
+		//Trust the checkpoint if it matches the data in flash, otherwise search for the end of the data
+		if((Datalogger_LoadCheckpoint(&StartingPage, &StartingLocationInPage) == 1) && (Datalogger_VerifyCursor(&StartingPage, &StartingLocationInPage, &StartingSequence) == 1))
 		{
-			if((SetupByte & DATALOGGER_INIT_RESTART_IF_FULL) == DATALOGGER_INIT_RESTART_IF_FULL)
-			{
-				DataSetAddress = 0;
-				DataPageAddress = 0;
-			}
-			else
+			printf_P(PSTR("Using checkpoint %u\n"), CheckpointSequence);
+		}
+		else
+		{
+			Datalogger_FindLastDataSet(&StartingPage, &StartingLocationInPage, &StartingSequence);
+		}
+		
+		//The log is full when the oldest data is right in front of the write cursor
+		if((SetupByte & DATALOGGER_INIT_STOP_IF_FULL) == DATALOGGER_INIT_STOP_IF_FULL)
+		{
+			TailPage = Datalogger_FindTail(StartingPage);
+			if( (TailPage != StartingPage) && (Datalogger_PagesBetween(StartingPage, TailPage) <= ((DATALOGGER_ERASE_AHEAD_BLOCKS + 1) * AT45DB321D_PAGES_PER_BLOCK)) )
 			{
 				DataloggerInitalized = 0;
 				return;
 			}
 		}
-		else
-		{
-			DataSetAddress = StartingLocationInPage;
-			DataPageAddress = StartingPage;
-		}
+		
+		DataSetAddress = StartingLocationInPage;
+		DataPageAddress = StartingPage;
+		DataPageSequence = StartingSequence;
 	}
 	else
 	{
-		DataSetAddress = 0;
+		//Keep counting up from the newest page so the old data in flash is seen as older than the new data
+		Datalogger_FindLastDataSet(&StartingPage, &StartingLocationInPage, &StartingSequence);
+		
+		DataSetAddress = DATALOGGER_PAGE_HEADER_SIZE;
 		DataPageAddress = 0;
+		DataPageSequence = StartingSequence + 1;
 	}
 	
 	BufferInUse = 1;
+	DataSetsInPage = 0;
+	DataTailValid = 0;
+	
+	//Load the partially written page so the data sets already in it are kept when the page is saved again
+	if(DataSetAddress > DATALOGGER_PAGE_HEADER_SIZE)
+	{
+		AT45DB321D_CopyPageToBuffer(BufferInUse, DataPageAddress);
+		Datalogger_ResumePage();
+	}
+	AT45DB321D_CacheSetPage(BufferInUse, DataPageAddress);
+	
+	Datalogger_FindRollupEnd(DATALOGGER_ROLLUP_HOURLY);
+	Datalogger_FindRollupEnd(DATALOGGER_ROLLUP_DAILY);
+	
+	//Start erasing at the next block boundary, the rest of the current block may already have data
+	ErasedStartPage = Datalogger_AddPages(DataPageAddress | (AT45DB321D_PAGES_PER_BLOCK - 1), 1);
+	ErasedEndPage = ErasedStartPage;
 	
 	printf_P(PSTR("Starting data collection in page 0x%04X at address 0x%04X\n"), DataPageAddress, DataSetAddress);
 	
@@ -96,247 +243,1574 @@ void Datalogger_Init(uint8_t SetupByte)
 
 void Datalogger_AddDataSet(uint8_t DataSet[])
 {
-	uint8_t DataSetHeader[2];
+	uint8_t Record[DATALOGGER_MAX_RECORD_SIZE];
+	uint8_t RecordSize;
 
 	if(DataloggerInitalized != 1)
 	{
 		return;
 	}
+	PROFILE_START(StartTime);
 	
-	DataSetHeader[0] = ((DataSetSizeBytes >> 4) | DATALOGGER_HEADER1_PREFIX);
-	DataSetHeader[1] = ((uint8_t)(DataSetSizeBytes << 4) | DATALOGGER_HEADER2_SUFFIX);
+	RecordSize = Datalogger_EncodeDataSet(DataSet, Record);
 	
-	//Write data set header
-	AT45DB321D_BufferWrite(BufferInUse, DataSetAddress, DataSetHeader, 2);
-	DataSetAddress += 2;
+	//If the page is full, start a new one. The data set is encoded again because the first data set in a page is stored in full.
+	if((DataSetsInPage >= DataSetsPerPage) || ((DataSetAddress + RecordSize) > DataloggerPageSize))
+	{
+		Datalogger_NextPage();
+		RecordSize = Datalogger_EncodeDataSet(DataSet, Record);
+	}
 	
-	//Write data
-	AT45DB321D_BufferWrite(BufferInUse, DataSetAddress, DataSet, DATALOGGER_DATASET_SIZE);
-	DataSetAddress += DATALOGGER_DATASET_SIZE;
+	//Write data. The page header is written when the page is saved to flash.
+	AT45DB321D_BufferWrite(BufferInUse, DataSetAddress, Record, RecordSize);
+	DataSetAddress += RecordSize;
+	Datalogger_UpdateZone(DataSet);
+	DataSetsInPage++;
 	
-	//Write CRC
-	#if DATALOGGER_USE_CRC == 1
-	AT45DB321D_BufferWrite(BufferInUse, DataSetAddress, DataSetCRC, 1);
-	DataSetAddress += 1;
-	#endif
+	Datalogger_UpdateRollups(DataSet);
 	
-	//If the page is full...
-	//fix this to handle CRC later
-	#if DATALOGGER_USE_CRC == 1
-	if((DataSetAddress + (DATALOGGER_DATASET_SIZE+3)) > DATALOGGER_PAGE_SIZE)
-	#else
-	if((DataSetAddress + (DATALOGGER_DATASET_SIZE+2)) > DATALOGGER_PAGE_SIZE)
-	#endif
+	PROFILE_STOP(PROFILE_ADDDATASET, StartTime);
+	return;
+}
+
+//Save the full page to flash and move to the next page.
+static void Datalogger_NextPage(void)
+{
+	//Save the data buffer to flash. Do not wait for the write to finish, the dataflash driver waits for it before the next command that needs it.
+	//The previous page has had a full page worth of data sets to finish writing, so this should not wait.
+	Datalogger_CommitPage(BufferInUse, DataPageAddress);
+	
+	//Switch to the other buffer. New data sets can be written to it while the full buffer is written to main memory.
+	if(BufferInUse == 1)
 	{
-		//Save the data buffer to flash
-		AT45DB321D_CopyBufferToPage(BufferInUse, DataPageAddress);
-		
-		//Switch to the other buffer (is this useful?)
-		if(BufferInUse == 1)
-		{
-			BufferInUse = 2;
-		}
-		else
-		{
-			BufferInUse = 1;
-		}
-		
-		//Increment page address
-		DataPageAddress++;
-		if(DataPageAddress > 0x1FFF)
-		{
-			DataPageAddress = 0;
-		}
-		
-		//Reset address in page to zero
-		DataSetAddress = 0;
+		BufferInUse = 2;
 	}
+	else
+	{
+		BufferInUse = 1;
+	}
+	
+	//Increment page address. The log is a ring, the oldest data is overwritten after the last page.
+	DataPageAddress++;
+	if(DataPageAddress >= DataloggerLogPages)
+	{
+		DataPageAddress = 0;
+	}
+	DataPageSequence++;
+	
+	//Keep the dataflash driver from loading other pages into the new buffer
+	AT45DB321D_CacheSetPage(BufferInUse, DataPageAddress);
 	
-	printf_P(PSTR("BufferInUse: %u\n"), BufferInUse);
-	printf_P(PSTR("DataSetAddress: %u\n"), DataSetAddress);
-	printf_P(PSTR("DataPageAddress: %u\n"), DataPageAddress);
+	//The first data set goes right after the page header
+	DataSetAddress = DATALOGGER_PAGE_HEADER_SIZE;
+	DataSetsInPage = 0;
 	
+	//The new page may have held the oldest data
+	DataTailValid = 0;
+	
+	//Each changed EEPROM byte takes 3.4 ms to write and wears the slot, so the cursor is only saved every few blocks
+	if((DataPageAddress % DATALOGGER_CHECKPOINT_INTERVAL) == 0)
+	{
+		Datalogger_SaveCheckpoint();
+	}
 	return;
 }
 
 void Datalogger_SaveDataToFlash(void)
 {
+	uint8_t Header[DATALOGGER_PAGE_HEADER_SIZE];
+	
 	if(DataloggerInitalized != 1)
 	{
 		return;
 	}
+	PROFILE_START(StartTime);
 
-	AT45DB321D_CopyBufferToPage(BufferInUse, DataPageAddress);
+	//The page will be written again when it is full, so it can not be treated as erased after this
+	if((ErasedStartPage == DataPageAddress) && (ErasedStartPage != ErasedEndPage))
+	{
+		ErasedStartPage = Datalogger_AddPages(ErasedStartPage, 1);
+	}
+	Datalogger_BuildHeader(Header);
+	AT45DB321D_ProgramPage(BufferInUse, DataPageAddress, 0, Header, DATALOGGER_PAGE_HEADER_SIZE);
 	AT45DB321D_WaitForReady();
+	
+	//More data sets go in the buffer, so it can not be used for other pages
+	AT45DB321D_CacheSetPage(BufferInUse, DataPageAddress);
+	Datalogger_SaveCheckpoint();
+	PROFILE_STOP(PROFILE_SAVEDATA, StartTime);
 	return;
 }
 
-//The page should always start with a dataset header.
-//The pages should always start at 0 and go up
-void Datalogger_FindLastDataSet(uint16_t *PageNumber, uint16_t *AddressInPage)
+//Write a buffer to a page. Pages that were erased ahead of time are written without the built in erase.
+//'PageNumber' must be the page being written, it is moved on if the page does not verify.
+static void Datalogger_CommitPage(uint8_t Buffer, uint16_t PageNumber)
 {
-	uint16_t PageToLook = 0;
-	uint16_t AddressToLook = 0;
-	uint8_t TempBuffer = 0;
-	
-	uint8_t TempVal[2];
-	uint8_t TempDataSetSize = 0;
-	
-	//Select the buffer that is not in use
-	if(BufferInUse == 1)
-	{
-		TempBuffer = 2;
-	}
-	else
-	{
-		TempBuffer = 1;
-	}
+	#if DATALOGGER_VERIFY_WRITES == 1
+	uint8_t Tries = 0;
+	uint8_t Relocations = 0;
+	#endif
+	PROFILE_START(StartTime);
 	
-	//printf_P(PSTR("Looking for data in page 0x%04X at address 0x%04X using buffer %u\n"), PageToLook, AddressToLook, TempBuffer);
+	Datalogger_WritePage(Buffer, PageNumber);
 	
-	while(PageToLook <= 0x1FFF)
+	#if DATALOGGER_VERIFY_WRITES == 1
+	//The compare is done on the device, so the page is not read back over SPI
+	while(AT45DB321D_VerifyPage(Buffer, PageNumber) == 0)
 	{
-		//printf_P(PSTR("Looking for data in page 0x%04X at address 0x%04X using buffer %u\n"), PageToLook, AddressToLook, TempBuffer);
-		
-		//Retrieve the memory page
-		AT45DB321D_CopyPageToBuffer(TempBuffer, PageToLook);
-		AT45DB321D_WaitForReady();
-		
-		//Look for the data start 
-		while(AddressToLook <= DATALOGGER_PAGE_SIZE)
+		if(Tries < DATALOGGER_WRITE_RETRIES)
 		{
-			AT45DB321D_BufferRead(TempBuffer, AddressToLook, TempVal, 2);
-			TempDataSetSize = ((TempVal[0] & 0x0F) << 4) | ((TempVal[1] & 0xF0) >> 4);
-			//printf_P(PSTR("0x%02X 0x%02X"), TempVal[0], TempVal[1]);
-			
-			if( ((TempVal[0] & 0xF0) == DATALOGGER_HEADER1_PREFIX) && ((TempVal[1] & 0x0F) == DATALOGGER_HEADER2_SUFFIX) && (TempDataSetSize > 0) )
-			{
-				//printf_P(PSTR("Header found at 0x%04X of size %u\n"), AddressToLook, TempDataSetSize);
-				AddressToLook += TempDataSetSize;
-			}
-			else
-			{
-				break;
-			}
+			Tries++;
+			AT45DB321D_CopyBufferToPage(Buffer, PageNumber);
+			continue;
 		}
 		
-		//Check if the page is full
-		if((AddressToLook + TempDataSetSize) > DATALOGGER_PAGE_SIZE)
-		{
-			PageToLook++;
-			AddressToLook = 0;
-		}
-		else
+		if(Relocations >= DATALOGGER_WRITE_RELOCATIONS)
 		{
+			printf_P(PSTR("Page 0x%04X did not verify\n"), PageNumber);
 			break;
 		}
+		
+		//Leave the bad page behind. It is erased so that its data sets are not read along with the copy in the next page.
+		//The copy keeps the same sequence number, so the sequence numbers count pages of data and the readers step over the pages without a header.
+		printf_P(PSTR("Page 0x%04X did not verify, moving to the next page\n"), PageNumber);
+		AT45DB321D_ErasePage(PageNumber);
+		Relocations++;
+		Tries = 0;
+		PageNumber = Datalogger_AddPages(PageNumber, 1);
+		DataPageAddress = PageNumber;
+		Datalogger_WritePage(Buffer, PageNumber);
 	}
+	#endif
+	PROFILE_STOP(PROFILE_COMMITPAGE, StartTime);
+	return;
+}
+
+//Add the page header to a buffer and write it to a page.
+//Pages that need the built in erase get the header and the write in a single command.
+static void Datalogger_WritePage(uint8_t Buffer, uint16_t PageNumber)
+{
+	uint8_t Header[DATALOGGER_PAGE_HEADER_SIZE];
 	
-	if(PageToLook == 0x1FFF)
+	Datalogger_BuildHeader(Header);
+	if((ErasedStartPage == PageNumber) && (ErasedStartPage != ErasedEndPage))
 	{
-		//printf_P(PSTR("The device is full\n"));
-		
-		*PageNumber = 0xFFFF;
-		*AddressInPage = 0xFFFF;
-		
-		return;
+		//Writing to an erased page is faster, even with the separate header write
+		AT45DB321D_BufferWrite(Buffer, 0, Header, DATALOGGER_PAGE_HEADER_SIZE);
+		AT45DB321D_CopyBufferToPageNoErase(Buffer, PageNumber);
+		ErasedStartPage = Datalogger_AddPages(ErasedStartPage, 1);
 	}
-	if( (PageToLook == 0x00) && (AddressToLook == 0x00) )
+	else
 	{
-		//printf_P(PSTR("The device is empty\n"));
-		
-		*PageNumber = 0x0000;
-		*AddressInPage = 0x0000;
-		
-		return;
+		AT45DB321D_ProgramPage(Buffer, PageNumber, 0, Header, DATALOGGER_PAGE_HEADER_SIZE);
 	}
+	return;
+}
+
+//Write the header for the current page to the start of a buffer.
+static void Datalogger_WriteHeader(uint8_t Buffer)
+{
+	uint8_t Header[DATALOGGER_PAGE_HEADER_SIZE];
 	
-	//printf_P(PSTR("Final data header is in page 0x%04X. New data should start at location 0x%04X\n"), PageToLook, AddressToLook);
+	Datalogger_BuildHeader(Header);
+	AT45DB321D_BufferWrite(Buffer, 0, Header, DATALOGGER_PAGE_HEADER_SIZE);
+	return;
+}
+
+//Make the header for the current page.
+static void Datalogger_BuildHeader(uint8_t Header[])
+{
+	uint8_t i;
 	
-	//printf_P(PSTR("Final data header is in page 0x%04X at address 0x%04X and is of size %u.\n"), PageToLook, AddressToLook-TempDataSetSize, TempDataSetSize);
-	//printf_P(PSTR("The next dataset should start at address 0x%04X\n"), AddressToLook);
+	Header[0] = DATALOGGER_PAGE_MAGIC;
+	Header[1] = DATALOGGER_PAGE_VERSION;
+	Header[2] = (uint8_t)(DataPageSequence >> 24);
+	Header[3] = (uint8_t)(DataPageSequence >> 16);
+	Header[4] = (uint8_t)(DataPageSequence >> 8);
+	Header[5] = (uint8_t)(DataPageSequence & 0xFF);
+	Header[6] = DATALOGGER_SCHEMA;
+	Header[7] = DataSetSizeBytes;
+	Header[8] = DataSetsInPage;
 	
-	*PageNumber = PageToLook;
-	*AddressInPage = AddressToLook;
+	Header[9] = (uint8_t)(PageZone.FirstTime >> 24);
+	Header[10] = (uint8_t)(PageZone.FirstTime >> 16);
+	Header[11] = (uint8_t)(PageZone.FirstTime >> 8);
+	Header[12] = (uint8_t)(PageZone.FirstTime & 0xFF);
+	Header[13] = (uint8_t)(PageZone.LastTime >> 24);
+	Header[14] = (uint8_t)(PageZone.LastTime >> 16);
+	Header[15] = (uint8_t)(PageZone.LastTime >> 8);
+	Header[16] = (uint8_t)(PageZone.LastTime & 0xFF);
+	for(i=0; i<DATALOGGER_ZONE_FIELDS; i++)
+	{
+		Header[17+4*i] = (uint8_t)(PageZone.Min[i] >> 8);
+		Header[18+4*i] = (uint8_t)(PageZone.Min[i] & 0xFF);
+		Header[19+4*i] = (uint8_t)(PageZone.Max[i] >> 8);
+		Header[20+4*i] = (uint8_t)(PageZone.Max[i] & 0xFF);
+	}
 	
+	Header[33] = (uint8_t)(DataSetAddress >> 8);
+	Header[34] = (uint8_t)(DataSetAddress & 0xFF);
+	Header[35] = 0;
+	for(i=0; i<35; i++)
+	{
+		Header[35] = _crc8_ccitt_update(Header[35], Header[i]);
+	}
 	return;
 }
 
-void Datalogger_ReadBackData(uint16_t NumberOfDataSets)
+//Read the page header from main memory, or from a buffer if the dataflash driver already has the page in one.
+//Returns 1 and fills in 'Header' if the page was written by the datalogger, returns 0 otherwise.
+static uint8_t Datalogger_ReadPageHeader(uint16_t PageNumber, DataloggerPageHeader *Header)
 {
-	uint16_t PageToLook = 0;
-	uint16_t AddressToLook = 0;
-	uint8_t TempBuffer = 0;
+	uint8_t HeaderBytes[DATALOGGER_PAGE_HEADER_SIZE];
+	uint8_t CRCValue = 0;
+	uint8_t Buffer = 0;
 	uint8_t i;
 	
-	uint8_t TempVal[2];
-	uint8_t TempDataSetSize = 0;
-	
-	//Select the buffer that is not in use
-	if(BufferInUse == 1)
+	//The buffer that holds the page being written does not have its header yet
+	if((DataloggerInitalized != 1) || (PageNumber != DataPageAddress))
+	{
+		Buffer = AT45DB321D_CacheFindPage(PageNumber);
+	}
+	if(Buffer != 0)
 	{
-		TempBuffer = 2;
+		AT45DB321D_BufferRead(Buffer, 0, HeaderBytes, DATALOGGER_PAGE_HEADER_SIZE);
 	}
 	else
 	{
-		TempBuffer = 1;
+		AT45DB321D_PageRead(PageNumber, 0, HeaderBytes, DATALOGGER_PAGE_HEADER_SIZE);
+	}
+	
+	for(i=0; i<35; i++)
+	{
+		CRCValue = _crc8_ccitt_update(CRCValue, HeaderBytes[i]);
+	}
+	if((HeaderBytes[0] != DATALOGGER_PAGE_MAGIC) || (HeaderBytes[1] != DATALOGGER_PAGE_VERSION) || (HeaderBytes[35] != CRCValue))
+	{
+		return 0;
+	}
+	
+	Header->Sequence = ((uint32_t)HeaderBytes[2] << 24) | ((uint32_t)HeaderBytes[3] << 16) | ((uint32_t)HeaderBytes[4] << 8) | HeaderBytes[5];
+	Header->Schema = HeaderBytes[6];
+	Header->RecordSize = HeaderBytes[7];
+	Header->RecordCount = HeaderBytes[8];
+	Header->Zone.FirstTime = ((uint32_t)HeaderBytes[9] << 24) | ((uint32_t)HeaderBytes[10] << 16) | ((uint32_t)HeaderBytes[11] << 8) | HeaderBytes[12];
+	Header->Zone.LastTime = ((uint32_t)HeaderBytes[13] << 24) | ((uint32_t)HeaderBytes[14] << 16) | ((uint32_t)HeaderBytes[15] << 8) | HeaderBytes[16];
+	for(i=0; i<DATALOGGER_ZONE_FIELDS; i++)
+	{
+		Header->Zone.Min[i] = ((uint16_t)HeaderBytes[17+4*i] << 8) | HeaderBytes[18+4*i];
+		Header->Zone.Max[i] = ((uint16_t)HeaderBytes[19+4*i] << 8) | HeaderBytes[20+4*i];
+	}
+	Header->EndOfData = ((uint16_t)HeaderBytes[33] << 8) | HeaderBytes[34];
+	return 1;
+}
+
+//Rebuild the count of data sets in the partially written page, its zone map, and the data set that the next one is encoded against.
+//The page must already be loaded into the buffer in use.
+static void Datalogger_ResumePage(void)
+{
+	DataloggerPageHeader Header;
+	uint8_t DataSet[DATALOGGER_DATASET_SIZE];
+	uint16_t AddressToLook = DATALOGGER_PAGE_HEADER_SIZE;
+	uint8_t RecordSize;
+	uint8_t Record;
+	
+	if(Datalogger_ReadPageHeader(DataPageAddress, &Header) != 1)
+	{
+		return;
+	}
+	
+	for(Record=0; Record<Header.RecordCount; Record++)
+	{
+		RecordSize = Datalogger_ReadDataSet(BufferInUse, DataPageAddress, AddressToLook, &Header, DataSet);
+		if(RecordSize == 0)
+		{
+			break;
+		}
+		AddressToLook += RecordSize;
+		Datalogger_UpdateZone(DataSet);
+		DataSetsInPage++;
+	}
+	
+	#if DATALOGGER_USE_COMPRESSION == 1
+	for(Record=0; Record<DATALOGGER_DATASET_SIZE; Record++)
+	{
+		LastDataSet[Record] = DataSet[Record];
+	}
+	#endif
+	return;
+}
+
+//Add a data set to the zone map of the current page. This must be called before DataSetsInPage is incremented.
+static void Datalogger_UpdateZone(uint8_t DataSet[])
+{
+	uint16_t Value;
+	uint8_t Offset;
+	uint8_t i;
+	
+	PageZone.LastTime = Datalogger_DataSetTime(DataSet);
+	if(DataSetsInPage == 0)
+	{
+		PageZone.FirstTime = PageZone.LastTime;
 	}
 	
-	//printf_P(PSTR("Looking for data in page 0x%04X at address 0x%04X using buffer %u\n"), PageToLook, AddressToLook, TempBuffer);
+	for(i=0; i<DATALOGGER_ZONE_FIELDS; i++)
+	{
+		Offset = pgm_read_byte(&ZoneFieldOffset[i]);
+		Value = ((uint16_t)DataSet[Offset] << 8) | DataSet[Offset+1];
+		if((DataSetsInPage == 0) || (Datalogger_FieldValue(Value, i+1) < Datalogger_FieldValue(PageZone.Min[i], i+1)))
+		{
+			PageZone.Min[i] = Value;
+		}
+		if((DataSetsInPage == 0) || (Datalogger_FieldValue(Value, i+1) > Datalogger_FieldValue(PageZone.Max[i], i+1)))
+		{
+			PageZone.Max[i] = Value;
+		}
+	}
+	return;
+}
+
+//Returns the time stamp of a data set as a number that goes up with time.
+static uint32_t Datalogger_DataSetTime(uint8_t DataSet[])
+{
+	return ((uint32_t)DataSet[0] << 24) | ((uint32_t)DataSet[1] << 16) | ((uint32_t)DataSet[2] << 8) | DataSet[3];
+}
+
+//Returns the value of a stored field. All fields except clear light are signed.
+static int32_t Datalogger_FieldValue(uint16_t RawValue, uint8_t Field)
+{
+	if(Field == DATALOGGER_FIELD_CLEAR)
+	{
+		return RawValue;
+	}
+	return (int16_t)RawValue;
+}
+
+//Returns the page 'PagesToAdd' pages after 'PageNumber'. The log is a ring, so this wraps from the last page of the log to page 0.
+static uint16_t Datalogger_AddPages(uint16_t PageNumber, uint16_t PagesToAdd)
+{
+	PageNumber += PagesToAdd;
+	if(PageNumber >= DataloggerLogPages)
+	{
+		PageNumber -= DataloggerLogPages;
+	}
+	return PageNumber;
+}
+
+//Returns the number of pages from 'FromPage' forward to 'ToPage'.
+static uint16_t Datalogger_PagesBetween(uint16_t FromPage, uint16_t ToPage)
+{
+	if(ToPage >= FromPage)
+	{
+		return ToPage - FromPage;
+	}
+	return ToPage + DataloggerLogPages - FromPage;
+}
+
+//Add a data set to the hourly and daily totals. The totals are saved to flash when the hour or day changes.
+static void Datalogger_UpdateRollups(uint8_t DataSet[])
+{
+	DataloggerRollup *Totals;
+	uint32_t Time;
+	uint16_t Value;
+	uint8_t Offset;
+	uint8_t Tier;
+	uint8_t i;
 	
-	while(PageToLook <= 0x1FFF)
+	for(Tier=0; Tier<2; Tier++)
 	{
-		//printf_P(PSTR("Looking for data in page 0x%04X at address 0x%04X using buffer %u\n"), PageToLook, AddressToLook, TempBuffer);
+		Totals = &RollupTotals[Tier];
+		Time = Datalogger_DataSetTime(DataSet);
+		Time -= Time % pgm_read_dword(&RollupPeriod[Tier]);
 		
-		//Retrieve the memory page
-		AT45DB321D_CopyPageToBuffer(TempBuffer, PageToLook);
-		AT45DB321D_WaitForReady();
+		if((Totals->Count > 0) && (Totals->Time != Time))
+		{
+			Datalogger_SaveRollup(Tier);
+			Totals->Count = 0;
+		}
+		if(Totals->Count == 0xFFFF)
+		{
+			continue;
+		}
 		
-		//Look for the data start 
-		while(AddressToLook <= DATALOGGER_PAGE_SIZE)
+		Totals->Time = Time;
+		for(i=0; i<DATALOGGER_ZONE_FIELDS; i++)
 		{
-			AT45DB321D_BufferRead(TempBuffer, AddressToLook, TempVal, 2);
-			TempDataSetSize = ((TempVal[0] & 0x0F) << 4) | ((TempVal[1] & 0xF0) >> 4);
-			//printf_P(PSTR("0x%02X 0x%02X"), TempVal[0], TempVal[1]);
-			
-			if( ((TempVal[0] & 0xF0) == DATALOGGER_HEADER1_PREFIX) && ((TempVal[1] & 0x0F) == DATALOGGER_HEADER2_SUFFIX) && (TempDataSetSize > 0) )
+			Offset = pgm_read_byte(&ZoneFieldOffset[i]);
+			Value = ((uint16_t)DataSet[Offset] << 8) | DataSet[Offset+1];
+			if(Totals->Count == 0)
 			{
-				NumberOfDataSets--;
-				for(i=2; i<TempDataSetSize; i++)
+				Totals->Sum[i] = Datalogger_FieldValue(Value, i+1);
+				Totals->Min[i] = Value;
+				Totals->Max[i] = Value;
+			}
+			else
+			{
+				Totals->Sum[i] += Datalogger_FieldValue(Value, i+1);
+				if(Datalogger_FieldValue(Value, i+1) < Datalogger_FieldValue(Totals->Min[i], i+1))
 				{
-					AT45DB321D_BufferRead(TempBuffer, AddressToLook+i, TempVal, 1);
-					AT45DB321D_WaitForReady();
-					printf_P(PSTR("0x%02X, "), TempVal[0]);
+					Totals->Min[i] = Value;
 				}
-				printf_P(PSTR("\b\b \b\n"));
-				if(NumberOfDataSets == 0)
+				if(Datalogger_FieldValue(Value, i+1) > Datalogger_FieldValue(Totals->Max[i], i+1))
 				{
-					return;
+					Totals->Max[i] = Value;
 				}
-				AddressToLook += TempDataSetSize;
 			}
-			else
+		}
+		Totals->Count++;
+	}
+	return;
+}
+
+//Append the totals for a finished hour or day to its rollup ring.
+//The record is written through the buffer that is not in use, with an erase and program of the rollup page.
+static void Datalogger_SaveRollup(uint8_t Tier)
+{
+	DataloggerRollup *Totals = &RollupTotals[Tier];
+	uint8_t Record[DATALOGGER_ROLLUP_RECORD_SIZE];
+	uint16_t PageNumber;
+	uint16_t AddressInPage;
+	uint8_t IdleBuffer;
+	uint8_t i;
+	
+	PageNumber = RollupFirstPage[Tier] + (RollupRecord[Tier] / RollupsPerPage);
+	AddressInPage = (RollupRecord[Tier] % RollupsPerPage) * DATALOGGER_ROLLUP_RECORD_SIZE;
+	
+	if(BufferInUse == 1)
+	{
+		IdleBuffer = 2;
+	}
+	else
+	{
+		IdleBuffer = 1;
+	}
+	//The idle buffer may still be being written to main memory, the buffer writes below wait for that
+	if(AddressInPage == 0)
+	{
+		//Blank the buffer so that the records from the last time around the ring are not written back
+		AT45DB321D_CacheSetPage(IdleBuffer, PageNumber);
+		for(i=0; i<DATALOGGER_ROLLUP_RECORD_SIZE; i++)
+		{
+			Record[i] = 0xFF;
+		}
+		while(AddressInPage < DataloggerPageSize)
+		{
+			i = DATALOGGER_ROLLUP_RECORD_SIZE;
+			if((DataloggerPageSize - AddressInPage) < i)
 			{
-				break;
+				i = DataloggerPageSize - AddressInPage;
 			}
+			AT45DB321D_BufferWrite(IdleBuffer, AddressInPage, Record, i);
+			AddressInPage += i;
 		}
-		
-		//Check if the page is full
-		if((AddressToLook + TempDataSetSize) > DATALOGGER_PAGE_SIZE)
+		AddressInPage = 0;
+	}
+	else
+	{
+		AT45DB321D_CopyPageToBuffer(IdleBuffer, PageNumber);
+	}
+	
+	Record[0] = DATALOGGER_ROLLUP_MAGIC;
+	Record[1] = (uint8_t)(RollupSequence[Tier] >> 8);
+	Record[2] = (uint8_t)(RollupSequence[Tier] & 0xFF);
+	Record[3] = (uint8_t)(Totals->Time >> 24);
+	Record[4] = (uint8_t)(Totals->Time >> 16);
+	Record[5] = (uint8_t)(Totals->Time >> 8);
+	Record[6] = (uint8_t)(Totals->Time & 0xFF);
+	Record[7] = (uint8_t)(Totals->Count >> 8);
+	Record[8] = (uint8_t)(Totals->Count & 0xFF);
+	for(i=0; i<DATALOGGER_ZONE_FIELDS; i++)
+	{
+		Record[9+8*i]	= (uint8_t)(Totals->Sum[i] >> 24);
+		Record[10+8*i]	= (uint8_t)(Totals->Sum[i] >> 16);
+		Record[11+8*i]	= (uint8_t)(Totals->Sum[i] >> 8);
+		Record[12+8*i]	= (uint8_t)(Totals->Sum[i] & 0xFF);
+		Record[13+8*i]	= (uint8_t)(Totals->Min[i] >> 8);
+		Record[14+8*i]	= (uint8_t)(Totals->Min[i] & 0xFF);
+		Record[15+8*i]	= (uint8_t)(Totals->Max[i] >> 8);
+		Record[16+8*i]	= (uint8_t)(Totals->Max[i] & 0xFF);
+	}
+	Record[41] = 0;
+	for(i=0; i<41; i++)
+	{
+		Record[41] = _crc8_ccitt_update(Record[41], Record[i]);
+	}
+	
+	//Do not wait for the write to finish
+	AT45DB321D_ProgramPage(IdleBuffer, PageNumber, AddressInPage, Record, DATALOGGER_ROLLUP_RECORD_SIZE);
+	
+	RollupRecord[Tier]++;
+	if(RollupRecord[Tier] >= RollupRecords[Tier])
+	{
+		RollupRecord[Tier] = 0;
+	}
+	RollupSequence[Tier]++;
+	return;
+}
+
+//Find the newest record in a rollup ring so that new records go after it. The totals in progress are cleared.
+//A rollup page is blanked when its first record is written, so the first records of the pages written since page 0 have
+//sequence numbers that step by RollupsPerPage. Those pages are found with a binary search and only the newest one is scanned.
+static void Datalogger_FindRollupEnd(uint8_t Tier)
+{
+	uint8_t Record[DATALOGGER_ROLLUP_RECORD_SIZE];
+	uint16_t RollupPages;
+	uint16_t LowPage;
+	uint16_t HighPage;
+	uint16_t MidPage;
+	uint16_t RecordNumber;
+	uint16_t AnchorSequence;
+	uint16_t Sequence;
+	uint8_t i;
+	
+	RollupRecord[Tier] = 0;
+	RollupSequence[Tier] = 0;
+	RollupTotals[Tier].Count = 0;
+	
+	//The rollup pages may still hold old log data, so only records with a good CRC count.
+	//The ring is written from record 0, so it is empty if the first record is not there.
+	if(Datalogger_ReadRollup(Tier, 0, Record) == 0)
+	{
+		return;
+	}
+	AnchorSequence = ((uint16_t)Record[1] << 8) | Record[2];
+	
+	//Pages below LowPage were written after page 0, pages at or above HighPage were not. The sequence number is allowed to wrap.
+	RollupPages = RollupRecords[Tier] / RollupsPerPage;
+	LowPage = 1;
+	HighPage = RollupPages;
+	while(LowPage < HighPage)
+	{
+		MidPage = LowPage + ((HighPage - LowPage) >> 1);
+		RecordNumber = MidPage * RollupsPerPage;
+		Sequence = AnchorSequence - 1;
+		if(Datalogger_ReadRollup(Tier, RecordNumber, Record) == 1)
+		{
+			Sequence = ((uint16_t)Record[1] << 8) | Record[2];
+		}
+		if((uint16_t)(Sequence - AnchorSequence) == RecordNumber)
 		{
-			PageToLook++;
-			AddressToLook = 0;
+			LowPage = MidPage + 1;
 		}
 		else
 		{
-			break;
+			HighPage = MidPage;
 		}
 	}
-
-
+	LowPage--;
+	
+	//Scan the newest page for its last record
+	RecordNumber = LowPage * RollupsPerPage;
+	Sequence = AnchorSequence + RecordNumber;
+	for(i=1; i<RollupsPerPage; i++)
+	{
+		if(Datalogger_ReadRollup(Tier, RecordNumber + 1, Record) == 0)
+		{
+			break;
+		}
+		if((((uint16_t)Record[1] << 8) | Record[2]) != (uint16_t)(Sequence + 1))
+		{
+			break;
+		}
+		RecordNumber++;
+		Sequence++;
+	}
+	
+	RollupSequence[Tier] = Sequence + 1;
+	RollupRecord[Tier] = RecordNumber + 1;
+	if(RollupRecord[Tier] >= RollupRecords[Tier])
+	{
+		RollupRecord[Tier] = 0;
+	}
+	return;
+}
+
+//Read record 'RecordNumber' of a rollup ring. Returns 1 if it has the magic byte and a good CRC, 0 otherwise.
+static uint8_t Datalogger_ReadRollup(uint8_t Tier, uint16_t RecordNumber, uint8_t Record[])
+{
+	uint8_t CRCValue = 0;
+	uint8_t i;
+	
+	AT45DB321D_PageRead(RollupFirstPage[Tier] + (RecordNumber / RollupsPerPage), (RecordNumber % RollupsPerPage) * DATALOGGER_ROLLUP_RECORD_SIZE, Record, DATALOGGER_ROLLUP_RECORD_SIZE);
+	if(Record[0] != DATALOGGER_ROLLUP_MAGIC)
+	{
+		return 0;
+	}
+	for(i=0; i<(DATALOGGER_ROLLUP_RECORD_SIZE-1); i++)
+	{
+		CRCValue = _crc8_ccitt_update(CRCValue, Record[i]);
+	}
+	if(Record[DATALOGGER_ROLLUP_RECORD_SIZE-1] != CRCValue)
+	{
+		return 0;
+	}
+	return 1;
+}
+
+void Datalogger_PrintRollups(uint8_t Tier, uint16_t NumberOfRollups)
+{
+	uint8_t Record[DATALOGGER_ROLLUP_RECORD_SIZE];
+	uint16_t RecordNumber;
+	uint16_t Count;
+	uint8_t i;
+	int32_t Sum;
+	TimeAndDate RollupTime;
+	
+	if((DataloggerInitalized != 1) || (Tier > DATALOGGER_ROLLUP_DAILY))
+	{
+		return;
+	}
+	if(NumberOfRollups > RollupRecords[Tier])
+	{
+		NumberOfRollups = RollupRecords[Tier];
+	}
+	
+	//Start 'NumberOfRollups' records before the next record to be written
+	RecordNumber = RollupRecord[Tier] + RollupRecords[Tier] - NumberOfRollups;
+	if(RecordNumber >= RollupRecords[Tier])
+	{
+		RecordNumber -= RollupRecords[Tier];
+	}
+	
+	while(NumberOfRollups > 0)
+	{
+		//Skip records that were never written
+		Count = 0;
+		if(Datalogger_ReadRollup(Tier, RecordNumber, Record) == 1)
+		{
+			Count = ((uint16_t)Record[7] << 8) | Record[8];
+		}
+		if(Count > 0)
+		{
+			EpochToTime(((uint32_t)Record[3] << 24) | ((uint32_t)Record[4] << 16) | ((uint32_t)Record[5] << 8) | Record[6], &RollupTime);
+			printf_P(PSTR("%02u/%02u/%04u %02u:00 %u"), RollupTime.month, RollupTime.day, RollupTime.year, RollupTime.hour, Count);
+			for(i=0; i<DATALOGGER_ZONE_FIELDS; i++)
+			{
+				Sum = (int32_t)(((uint32_t)Record[9+8*i] << 24) | ((uint32_t)Record[10+8*i] << 16) | ((uint32_t)Record[11+8*i] << 8) | Record[12+8*i]);
+				printf_P(PSTR(", %ld %ld %ld"), Sum/Count, Datalogger_FieldValue(((uint16_t)Record[13+8*i] << 8) | Record[14+8*i], i+1), Datalogger_FieldValue(((uint16_t)Record[15+8*i] << 8) | Record[16+8*i], i+1));
+			}
+			printf_P(PSTR("\n"));
+		}
+		
+		RecordNumber++;
+		if(RecordNumber >= RollupRecords[Tier])
+		{
+			RecordNumber = 0;
+		}
+		NumberOfRollups--;
+	}
+	return;
+}
+
+//Get the header of a page in the log. The page being written has no header in flash yet, so its header comes from the current state.
+//Returns the buffer that holds the page, or 0 if the page is read from main memory. The record count is 0 if the page has no valid header.
+static uint8_t Datalogger_GetPageHeader(uint16_t PageNumber, DataloggerPageHeader *Header)
+{
+	if(PageNumber == DataPageAddress)
+	{
+		Header->Sequence = DataPageSequence;
+		Header->Schema = DATALOGGER_SCHEMA;
+		Header->RecordSize = DataSetSizeBytes;
+		Header->RecordCount = DataSetsInPage;
+		Header->EndOfData = DataSetAddress;
+		Header->Zone = PageZone;
+		return BufferInUse;
+	}
+	
+	if(Datalogger_ReadPageHeader(PageNumber, Header) != 1)
+	{
+		Header->RecordCount = 0;
+	}
+	return 0;
+}
+
+//Encode a data set the way it is stored in the current page. Returns the size of the encoded data set.
+static uint8_t Datalogger_EncodeDataSet(uint8_t DataSet[], uint8_t Record[])
+{
+	uint8_t i;
+	#if DATALOGGER_USE_COMPRESSION == 1
+	uint8_t RecordSize;
+	uint8_t Word;
+	uint16_t Change;
+	
+	//The first data set in a page is stored in full so that each page can be decoded on its own
+	if(DataSetsInPage == 0)
+	{
+		for(i=0; i<DATALOGGER_DATASET_SIZE; i++)
+		{
+			Record[i] = DataSet[i];
+			LastDataSet[i] = DataSet[i];
+		}
+		return DATALOGGER_DATASET_SIZE;
+	}
+	
+	Record[0] = 0;
+	RecordSize = 1;
+	for(Word=0; Word<(DATALOGGER_DATASET_SIZE/2); Word++)
+	{
+		Change = (((uint16_t)DataSet[2*Word] << 8) | DataSet[2*Word+1]) - (((uint16_t)LastDataSet[2*Word] << 8) | LastDataSet[2*Word+1]);
+		
+		//The low time word is always stored, the other words only if they changed
+		if(Word != 1)
+		{
+			if(Change == 0)
+			{
+				continue;
+			}
+			if(Word == 0)
+			{
+				Record[0] |= 0x80;
+			}
+			else
+			{
+				Record[0] |= (1 << (Word - 2));
+			}
+		}
+		
+		//Zig-zag encode so that small negative changes are small numbers, then store as a varint
+		Change = (Change << 1) ^ (uint16_t)((int16_t)Change >> 15);
+		while(Change >= 0x80)
+		{
+			Record[RecordSize++] = (uint8_t)(Change | 0x80);
+			Change >>= 7;
+		}
+		Record[RecordSize++] = (uint8_t)Change;
+	}
+	
+	for(i=0; i<DATALOGGER_DATASET_SIZE; i++)
+	{
+		LastDataSet[i] = DataSet[i];
+	}
+	return RecordSize;
+	#else
+	for(i=0; i<DATALOGGER_DATASET_SIZE; i++)
+	{
+		Record[i] = DataSet[i];
+	}
+	
+	#if DATALOGGER_USE_CRC == 1
+	Record[DATALOGGER_DATASET_SIZE] = 0;
+	for(i=0; i<DATALOGGER_DATASET_SIZE; i++)
+	{
+		Record[DATALOGGER_DATASET_SIZE] = _crc8_ccitt_update(Record[DATALOGGER_DATASET_SIZE], DataSet[i]);
+	}
+	#endif
+	return DataSetSizeBytes;
+	#endif
+}
+
+//Apply a delta encoded data set to the data set before it. 'DataSet' holds the data set before it, and is updated in place.
+//Returns the size of the encoded data set.
+static uint8_t Datalogger_DecodeDataSet(uint8_t Record[], uint8_t DataSet[])
+{
+	uint8_t RecordSize = 1;
+	uint8_t Word;
+	uint8_t Shift;
+	uint16_t Change;
+	uint16_t Value;
+	
+	for(Word=0; Word<(DATALOGGER_DATASET_SIZE/2); Word++)
+	{
+		if( ((Word == 0) && ((Record[0] & 0x80) == 0)) || ((Word > 1) && ((Record[0] & (1 << (Word - 2))) == 0)) )
+		{
+			continue;
+		}
+		
+		Change = 0;
+		Shift = 0;
+		do
+		{
+			Change |= (uint16_t)(Record[RecordSize] & 0x7F) << Shift;
+			Shift += 7;
+		} while(((Record[RecordSize++] & 0x80) != 0) && (Shift < 21));
+		Change = (Change >> 1) ^ (uint16_t)(-(int16_t)(Change & 0x01));
+		
+		Value = (((uint16_t)DataSet[2*Word] << 8) | DataSet[2*Word+1]) + Change;
+		DataSet[2*Word] = (uint8_t)(Value >> 8);
+		DataSet[2*Word+1] = (uint8_t)(Value & 0xFF);
+	}
+	return RecordSize;
+}
+
+//Read the data set at 'AddressInPage' from buffer 'Buffer', or from main memory if 'Buffer' is 0.
+//For delta encoded pages, 'DataSet' must hold the data set before it in the page.
+//Returns the size of the stored data set, or 0 if the page schema is not known.
+static uint8_t Datalogger_ReadDataSet(uint8_t Buffer, uint16_t PageNumber, uint16_t AddressInPage, DataloggerPageHeader *Header, uint8_t DataSet[])
+{
+	uint8_t Record[DATALOGGER_MAX_RECORD_SIZE];
+	uint8_t BytesToRead;
+	uint8_t i;
+	
+	if(Header->Schema == DATALOGGER_SCHEMA_FIXED)
+	{
+		BytesToRead = Header->RecordSize;
+	}
+	else if(Header->Schema == DATALOGGER_SCHEMA_DELTA)
+	{
+		BytesToRead = DATALOGGER_MAX_RECORD_SIZE;
+	}
+	else
+	{
+		return 0;
+	}
+	
+	if((BytesToRead == 0) || (BytesToRead > DATALOGGER_MAX_RECORD_SIZE))
+	{
+		return 0;
+	}
+	if((AddressInPage + BytesToRead) > DataloggerPageSize)
+	{
+		BytesToRead = DataloggerPageSize - AddressInPage;
+	}
+	
+	if(Buffer == 0)
+	{
+		AT45DB321D_PageRead(PageNumber, AddressInPage, Record, BytesToRead);
+	}
+	else
+	{
+		AT45DB321D_BufferRead(Buffer, AddressInPage, Record, BytesToRead);
+	}
+	
+	//Fixed size data sets, and the first data set in a delta encoded page, are stored in full
+	if((Header->Schema == DATALOGGER_SCHEMA_FIXED) || (AddressInPage == DATALOGGER_PAGE_HEADER_SIZE))
+	{
+		for(i=0; i<DATALOGGER_DATASET_SIZE; i++)
+		{
+			DataSet[i] = Record[i];
+		}
+		if(Header->Schema == DATALOGGER_SCHEMA_FIXED)
+		{
+			return Header->RecordSize;
+		}
+		return DATALOGGER_DATASET_SIZE;
+	}
+	
+	return Datalogger_DecodeDataSet(Record, DataSet);
+}
+
+void Datalogger_Task(void)
+{
+	if(DataloggerInitalized != 1)
+	{
+		return;
+	}
+	
+	//All of the erased pages have been used, start again at the next block boundary
+	if(ErasedStartPage == ErasedEndPage)
+	{
+		ErasedStartPage = Datalogger_AddPages(DataPageAddress | (AT45DB321D_PAGES_PER_BLOCK - 1), 1);
+		ErasedEndPage = ErasedStartPage;
+	}
+	
+	//Enough blocks are erased already
+	if(Datalogger_PagesBetween(DataPageAddress, ErasedEndPage) >= (DATALOGGER_ERASE_AHEAD_BLOCKS * AT45DB321D_PAGES_PER_BLOCK))
+	{
+		return;
+	}
+	
+	//Do not wait on the flash here, try again later if it is busy
+	if(AT45DB321D_IsReady() == 0)
+	{
+		return;
+	}
+	
+	AT45DB321D_BlockErase(ErasedEndPage / AT45DB321D_PAGES_PER_BLOCK);
+	DataTailValid = 0;
+	ErasedEndPage = Datalogger_AddPages(ErasedEndPage, AT45DB321D_PAGES_PER_BLOCK);
+	
+	return;
+}
+
+static uint8_t Datalogger_CheckpointCRC(DataloggerCheckpoint *Checkpoint)
+{
+	uint8_t *CheckpointBytes = (uint8_t *)Checkpoint;
+	uint8_t CRCValue = 0;
+	uint8_t i;
+	
+	for(i=0; i<(sizeof(DataloggerCheckpoint)-1); i++)
+	{
+		CRCValue = _crc8_ccitt_update(CRCValue, CheckpointBytes[i]);
+	}
+	return CRCValue;
+}
+
+void Datalogger_SaveCheckpoint(void)
+{
+	DataloggerCheckpoint Checkpoint;
+	
+	CheckpointSequence++;
+	
+	Checkpoint.Page		= DataPageAddress;
+	Checkpoint.Address	= DataSetAddress;
+	Checkpoint.Sequence	= CheckpointSequence;
+	Checkpoint.CRC		= Datalogger_CheckpointCRC(&Checkpoint);
+	
+	eeprom_update_block(&Checkpoint, &CheckpointSlots[CheckpointSlot], sizeof(DataloggerCheckpoint));
+	
+	CheckpointSlot++;
+	if(CheckpointSlot >= DATALOGGER_CHECKPOINT_SLOTS)
+	{
+		CheckpointSlot = 0;
+	}
+	return;
+}
+
+uint8_t Datalogger_LoadCheckpoint(uint16_t *PageNumber, uint16_t *AddressInPage)
+{
+	DataloggerCheckpoint Checkpoint;
+	uint8_t Found = 0;
+	uint8_t i;
+	
+	CheckpointSlot = 0;
+	CheckpointSequence = 0;
+	
+	for(i=0; i<DATALOGGER_CHECKPOINT_SLOTS; i++)
+	{
+		eeprom_read_block(&Checkpoint, &CheckpointSlots[i], sizeof(DataloggerCheckpoint));
+		
+		//Skip erased and corrupt slots
+		if((Checkpoint.Page >= DataloggerLogPages) || (Checkpoint.Address >= DataloggerPageSize) || (Checkpoint.CRC != Datalogger_CheckpointCRC(&Checkpoint)))
+		{
+			continue;
+		}
+		
+		//Keep the newest checkpoint. The sequence number is allowed to wrap.
+		if((Found == 0) || ((int16_t)(Checkpoint.Sequence - CheckpointSequence) > 0))
+		{
+			Found = 1;
+			CheckpointSequence = Checkpoint.Sequence;
+			*PageNumber = Checkpoint.Page;
+			*AddressInPage = Checkpoint.Address;
+			
+			CheckpointSlot = i + 1;
+			if(CheckpointSlot >= DATALOGGER_CHECKPOINT_SLOTS)
+			{
+				CheckpointSlot = 0;
+			}
+		}
+	}
+	return Found;
+}
+
+//Check a checkpoint against the flash and move it forward to the end of the data. Returns 1 and sets 'PageSequence' to the sequence number of
+//the page at the new cursor if the data in flash ends at the checkpoint or within the pages written since it was saved.
+//Only the headers of the page the checkpoint was taken on and the pages after it are read.
+static uint8_t Datalogger_VerifyCursor(uint16_t *PageNumber, uint16_t *AddressInPage, uint32_t *PageSequence)
+{
+	DataloggerPageHeader Header;
+	uint16_t AnchorPage;
+	uint16_t PagesAfter;
+	
+	//A checkpoint at the start of a page was taken just after the page before it was written.
+	//A checkpoint part way into a page was taken when that page was saved, and the data sets in it must reach the cursor.
+	AnchorPage = *PageNumber;
+	if(*AddressInPage == DATALOGGER_PAGE_HEADER_SIZE)
+	{
+		AnchorPage = Datalogger_AddPages(*PageNumber, DataloggerLogPages - 1);
+	}
+	if(Datalogger_ReadPageHeader(AnchorPage, &Header) != 1)
+	{
+		return 0;
+	}
+	if((*AddressInPage != DATALOGGER_PAGE_HEADER_SIZE) && (Header.EndOfData < *AddressInPage))
+	{
+		return 0;
+	}
+	
+	//Roll forward over the pages written since the checkpoint. If there are more than two intervals of them, a search is just as fast.
+	PagesAfter = 0;
+	while(Datalogger_PageFollows(Datalogger_AddPages(AnchorPage, PagesAfter + 1), Header.Sequence, PagesAfter + 1) == 1)
+	{
+		PagesAfter++;
+		if(PagesAfter > (2 * DATALOGGER_CHECKPOINT_INTERVAL))
+		{
+			return 0;
+		}
+	}
+	
+	Datalogger_CursorAfterPage(Datalogger_AddPages(AnchorPage, PagesAfter), PageNumber, AddressInPage, PageSequence);
+	return 1;
+}
+
+//Read the header of 'PageNumber', or if it has none, of the first page after it that has one. Datalogger_CommitPage leaves up to
+//DATALOGGER_WRITE_RELOCATIONS erased pages in a row behind when pages do not verify. The search wraps from the last page of the log to page 0.
+//Returns the number of pages stepped over, or 0xFF if none of the pages has a header.
+static uint8_t Datalogger_ReadNextHeader(uint16_t PageNumber, DataloggerPageHeader *Header)
+{
+	uint8_t Skipped;
+	
+	for(Skipped=0; Skipped<=DATALOGGER_WRITE_RELOCATIONS; Skipped++)
+	{
+		if(Datalogger_ReadPageHeader(Datalogger_AddPages(PageNumber, Skipped), Header) == 1)
+		{
+			return Skipped;
+		}
+	}
+	return 0xFF;
+}
+
+//Returns 1 if page 'PageNumber', which is 'PagesAfter' pages after the page with sequence number 'Sequence', was written after that page.
+//Relocated pages do not use up a sequence number, so a later page can be closer in sequence than it is in pages, but never further.
+//A page without a header is part of the run if the page with data after it is.
+static uint8_t Datalogger_PageFollows(uint16_t PageNumber, uint32_t Sequence, uint16_t PagesAfter)
+{
+	DataloggerPageHeader Header;
+	uint8_t Skipped;
+	
+	Skipped = Datalogger_ReadNextHeader(PageNumber, &Header);
+	if(Skipped == 0xFF)
+	{
+		return 0;
+	}
+	if((Header.Sequence <= Sequence) || ((Header.Sequence - Sequence) > ((uint32_t)PagesAfter + Skipped)))
+	{
+		return 0;
+	}
+	return 1;
+}
+
+//The log is a ring of pages. Starting after the newest page there are erased pages, then the oldest pages.
+//Each page has a sequence number that is one more than the page written before it.
+void Datalogger_FindLastDataSet(uint16_t *PageNumber, uint16_t *AddressInPage, uint32_t *PageSequence)
+{
+	uint16_t AnchorPage = 0;
+	uint32_t AnchorSequence = 0;
+	uint16_t LowPage;
+	uint16_t HighPage;
+	uint16_t MidPage;
+	uint8_t i;
+	DataloggerPageHeader Header;
+	
+	//Find a page with data near the start of the flash.
+	//Page 0 only lacks data if the log is empty, or if it was erased ahead of the newest page at the end of the flash.
+	//The erase is done in blocks, so only the start of the first few blocks need to be checked.
+	for(i=0; i<(DATALOGGER_ERASE_AHEAD_BLOCKS + 2); i++)
+	{
+		AnchorPage = (uint16_t)i * AT45DB321D_PAGES_PER_BLOCK;
+		if(Datalogger_ReadPageHeader(AnchorPage, &Header) == 1)
+		{
+			AnchorSequence = Header.Sequence;
+			break;
+		}
+	}
+	
+	if(i >= (DATALOGGER_ERASE_AHEAD_BLOCKS + 2))
+	{
+		//printf_P(PSTR("The device is empty\n"));
+		
+		*PageNumber = 0x0000;
+		*AddressInPage = DATALOGGER_PAGE_HEADER_SIZE;
+		*PageSequence = 0;
+		
+		return;
+	}
+	
+	//Binary search for the newest page. Pages after the anchor page are part of the same run of pages up to the newest page.
+	//After that the pages are either erased or older. Pages below LowPage are in the run, pages at or above HighPage are not.
+	LowPage = AnchorPage + 1;
+	HighPage = DataloggerLogPages;
+	while(LowPage < HighPage)
+	{
+		MidPage = LowPage + ((HighPage - LowPage) >> 1);
+		if(Datalogger_PageFollows(MidPage, AnchorSequence, MidPage - AnchorPage) == 1)
+		{
+			LowPage = MidPage + 1;
+		}
+		else
+		{
+			HighPage = MidPage;
+		}
+	}
+	LowPage--;
+	
+	Datalogger_CursorAfterPage(LowPage, PageNumber, AddressInPage, PageSequence);
+	return;
+}
+
+//Set the write cursor to the end of the data in 'NewestPage', which must have a valid header.
+//The header of the newest page says where the data ends. Pages that are full or were written with a different schema are not appended to.
+static void Datalogger_CursorAfterPage(uint16_t NewestPage, uint16_t *PageNumber, uint16_t *AddressInPage, uint32_t *PageSequence)
+{
+	DataloggerPageHeader Header;
+	
+	Datalogger_ReadPageHeader(NewestPage, &Header);
+	*PageSequence = Header.Sequence;
+	if((Header.Schema != DATALOGGER_SCHEMA) || (Header.RecordSize != DataSetSizeBytes) || (Header.RecordCount >= DataSetsPerPage) || (Header.EndOfData > DataloggerPageSize))
+	{
+		//New data starts on the next page
+		*PageNumber = Datalogger_AddPages(NewestPage, 1);
+		*AddressInPage = DATALOGGER_PAGE_HEADER_SIZE;
+		*PageSequence += 1;
+		
+		return;
+	}
+	
+	//printf_P(PSTR("Final data set is in page 0x%04X. New data should start at location 0x%04X\n"), NewestPage, Header.EndOfData);
+	
+	*PageNumber = NewestPage;
+	*AddressInPage = Header.EndOfData;
+	
+	return;
+}
+
+//Find the oldest page in the log. 'HeadPage' is the page that is being written.
+//The pages after the head page are erased until the oldest page is reached, so the oldest page is found with a binary search.
+static uint16_t Datalogger_FindTail(uint16_t HeadPage)
+{
+	DataloggerPageHeader Header;
+	uint16_t LowOffset;
+	uint16_t HighOffset;
+	uint16_t MidOffset;
+	
+	//Blocks are erased from the next block boundary, so the rest of the head block may still have the oldest data
+	if(((HeadPage + 1) % AT45DB321D_PAGES_PER_BLOCK) != 0)
+	{
+		if(Datalogger_ReadPageHeader(Datalogger_AddPages(HeadPage, 1), &Header) == 1)
+		{
+			return Datalogger_AddPages(HeadPage, 1);
+		}
+	}
+	
+	//Offsets below LowOffset are erased, offsets at or above HighOffset have data. A relocated page in the old data counts as data.
+	LowOffset = 1;
+	HighOffset = DataloggerLogPages;
+	while(LowOffset < HighOffset)
+	{
+		MidOffset = LowOffset + ((HighOffset - LowOffset) >> 1);
+		if(Datalogger_ReadNextHeader(Datalogger_AddPages(HeadPage, MidOffset), &Header) != 0xFF)
+		{
+			HighOffset = MidOffset;
+		}
+		else
+		{
+			LowOffset = MidOffset + 1;
+		}
+	}
+	
+	//If no other page has data, the log starts in the head page. The tail is the first page with a header.
+	if(LowOffset < DataloggerLogPages)
+	{
+		LowOffset += Datalogger_ReadNextHeader(Datalogger_AddPages(HeadPage, LowOffset), &Header);
+		if(LowOffset > DataloggerLogPages)
+		{
+			LowOffset = DataloggerLogPages;
+		}
+	}
+	return Datalogger_AddPages(HeadPage, LowOffset);
+}
+
+//Returns the oldest page in the log. The tail only moves when a page is written or a block is erased, so it is only searched for after that.
+//The flash must not be busy.
+static uint16_t Datalogger_GetTail(void)
+{
+	DataloggerPageHeader Header;
+	
+	if(DataTailValid != 1)
+	{
+		DataTailPage = Datalogger_FindTail(DataPageAddress);
+		DataTailSequence = DataPageSequence;
+		if((DataTailPage != DataPageAddress) && (Datalogger_ReadPageHeader(DataTailPage, &Header) == 1))
+		{
+			DataTailSequence = Header.Sequence;
+		}
+		DataTailValid = 1;
+	}
+	return DataTailPage;
+}
+
+uint32_t Datalogger_GetDataSetCount(void)
+{
+	if((DataloggerInitalized != 1) || (DATALOGGER_SCHEMA != DATALOGGER_SCHEMA_FIXED))
+	{
+		return 0;
+	}
+	
+	//The sequence numbers count the pages with data, relocated pages are not counted
+	Datalogger_GetTail();
+	return ((DataPageSequence - DataTailSequence) * DataSetsPerPage) + DataSetsInPage;
+}
+
+//Returns the page in the log with sequence number 'Sequence', or DataloggerLogPages if it is not found.
+//A page is never closer to the tail in pages than it is in sequence numbers, so the search starts there and steps forward over the relocated pages.
+static uint16_t Datalogger_FindSequence(uint32_t Sequence)
+{
+	DataloggerPageHeader Header;
+	uint16_t PageNumber;
+	uint16_t PagesLeft;
+	uint16_t Step;
+	
+	Datalogger_GetTail();
+	if((Sequence < DataTailSequence) || (Sequence > DataPageSequence))
+	{
+		return DataloggerLogPages;
+	}
+	
+	PageNumber = Datalogger_AddPages(DataTailPage, (uint16_t)(Sequence - DataTailSequence));
+	PagesLeft = Datalogger_PagesBetween(PageNumber, DataPageAddress);
+	while(1)
+	{
+		if(PageNumber == DataPageAddress)
+		{
+			if(Sequence == DataPageSequence)
+			{
+				return PageNumber;
+			}
+			return DataloggerLogPages;
+		}
+		
+		Step = 1;
+		if(Datalogger_ReadPageHeader(PageNumber, &Header) == 1)
+		{
+			if(Header.Sequence == Sequence)
+			{
+				return PageNumber;
+			}
+			if(Header.Sequence > Sequence)
+			{
+				return DataloggerLogPages;
+			}
+			if((Sequence - Header.Sequence) < PagesLeft)
+			{
+				Step = Sequence - Header.Sequence;
+			}
+		}
+		if(Step > PagesLeft)
+		{
+			return DataloggerLogPages;
+		}
+		PageNumber = Datalogger_AddPages(PageNumber, Step);
+		PagesLeft -= Step;
+	}
+}
+
+uint8_t Datalogger_RetrieveDataFromFlash(uint32_t DataSetNumber, uint8_t DataSet[])
+{
+	DataloggerPageHeader Header;
+	uint32_t PageOffset;
+	uint16_t PageNumber;
+	uint16_t AddressInPage;
+	uint8_t NumberInPage;
+	
+	if((DataloggerInitalized != 1) || (DATALOGGER_SCHEMA != DATALOGGER_SCHEMA_FIXED))
+	{
+		return 0;
+	}
+	
+	//Every page of data before the page being written is full. Pages that were relocated are stepped over.
+	PageOffset = DataSetNumber / DataSetsPerPage;
+	NumberInPage = DataSetNumber % DataSetsPerPage;
+	Datalogger_GetTail();
+	if(PageOffset > (DataPageSequence - DataTailSequence))
+	{
+		return 0;
+	}
+	PageNumber = Datalogger_FindSequence(DataTailSequence + PageOffset);
+	if(PageNumber >= DataloggerLogPages)
+	{
+		return 0;
+	}
+	AddressInPage = DATALOGGER_PAGE_HEADER_SIZE + (uint16_t)NumberInPage * DataSetSizeBytes;
+	
+	//The page being written is only in the buffer in use
+	if(PageNumber == DataPageAddress)
+	{
+		if(NumberInPage >= DataSetsInPage)
+		{
+			return 0;
+		}
+		AT45DB321D_BufferRead(BufferInUse, AddressInPage, DataSet, DATALOGGER_DATASET_SIZE);
+		return 1;
+	}
+	
+	//Pages written by another version of the firmware may have a different layout
+	if((Datalogger_ReadPageHeader(PageNumber, &Header) != 1) || (Header.Schema != DATALOGGER_SCHEMA_FIXED) || (Header.RecordSize != DataSetSizeBytes) || (NumberInPage >= Header.RecordCount))
+	{
+		return 0;
+	}
+	AT45DB321D_PageRead(PageNumber, AddressInPage, DataSet, DATALOGGER_DATASET_SIZE);
+	return 1;
+}
+
+uint16_t Datalogger_Query(uint32_t StartTime, uint32_t EndTime, uint8_t Field, int32_t Low, int32_t High)
+{
+	DataloggerPageHeader Header;
+	uint8_t DataSet[DATALOGGER_DATASET_SIZE];
+	uint16_t TailPage;
+	uint16_t FullPages;
+	uint16_t LowOffset;
+	uint16_t HighOffset;
+	uint16_t MidOffset;
+	uint16_t PageNumber;
+	uint16_t AddressToLook;
+	uint16_t Matches = 0;
+	uint8_t ReadBuffer;
+	uint8_t RecordSize;
+	uint8_t Record;
+	uint8_t Offset;
+	uint8_t i;
+	int32_t Value;
+	
+	if((DataloggerInitalized != 1) || (Field > DATALOGGER_FIELD_CLEAR))
+	{
+		return 0;
+	}
+	
+	TailPage = Datalogger_GetTail();
+	FullPages = Datalogger_PagesBetween(TailPage, DataPageAddress);
+	
+	//Pages are written in time order. Binary search for the first full page that ends at or after the start time.
+	LowOffset = 0;
+	HighOffset = FullPages;
+	while(LowOffset < HighOffset)
+	{
+		MidOffset = LowOffset + ((HighOffset - LowOffset) >> 1);
+		if((Datalogger_ReadNextHeader(Datalogger_AddPages(TailPage, MidOffset), &Header) != 0xFF) && (Header.RecordCount > 0) && (Header.Zone.LastTime >= StartTime))
+		{
+			HighOffset = MidOffset;
+		}
+		else
+		{
+			LowOffset = MidOffset + 1;
+		}
+	}
+	
+	//Check each page up to and including the page being written
+	for(; LowOffset <= FullPages; LowOffset++)
+	{
+		PageNumber = Datalogger_AddPages(TailPage, LowOffset);
+		ReadBuffer = Datalogger_GetPageHeader(PageNumber, &Header);
+		if(Header.RecordCount == 0)
+		{
+			continue;
+		}
+		
+		//The rest of the pages are newer
+		if(Header.Zone.FirstTime > EndTime)
+		{
+			break;
+		}
+		
+		//Skip pages where the zone map shows there are no matches
+		if(Header.Zone.LastTime < StartTime)
+		{
+			continue;
+		}
+		if(Field != DATALOGGER_FIELD_TIME)
+		{
+			if((Datalogger_FieldValue(Header.Zone.Max[Field-1], Field) < Low) || (Datalogger_FieldValue(Header.Zone.Min[Field-1], Field) > High))
+			{
+				continue;
+			}
+		}
+		
+		//Read the data sets from a buffer. Pages that are looked at again by the next query are still there.
+		if(ReadBuffer == 0)
+		{
+			ReadBuffer = AT45DB321D_CacheLoadPage(PageNumber);
+		}
+		
+		AddressToLook = DATALOGGER_PAGE_HEADER_SIZE;
+		for(Record=0; Record<Header.RecordCount; Record++)
+		{
+			RecordSize = Datalogger_ReadDataSet(ReadBuffer, PageNumber, AddressToLook, &Header, DataSet);
+			if(RecordSize == 0)
+			{
+				break;
+			}
+			AddressToLook += RecordSize;
+			
+			if((Datalogger_DataSetTime(DataSet) < StartTime) || (Datalogger_DataSetTime(DataSet) > EndTime))
+			{
+				continue;
+			}
+			if(Field != DATALOGGER_FIELD_TIME)
+			{
+				Offset = pgm_read_byte(&ZoneFieldOffset[Field-1]);
+				Value = Datalogger_FieldValue(((uint16_t)DataSet[Offset] << 8) | DataSet[Offset+1], Field);
+				if((Value < Low) || (Value > High))
+				{
+					continue;
+				}
+			}
+			
+			Matches++;
+			for(i=0; i<DATALOGGER_DATASET_SIZE; i++)
+			{
+				printf_P(PSTR("0x%02X, "), DataSet[i]);
+			}
+			printf_P(PSTR("\b\b \b\n"));
+		}
+	}
+	
+	return Matches;
+}
+
+void Datalogger_DumpData(void)
+{
+	uint8_t Chunk[DATALOGGER_DUMP_CHUNK];
+	uint32_t BytesLeft;
+	uint16_t TailPage;
+	uint16_t FullPages;
+	uint16_t PageToRead;
+	uint16_t PagesToRead;
+	uint16_t BufferAddress = 0;
+	uint16_t LastPageBytes = 0;
+	uint16_t CRCValue = 0xFFFF;
+	uint8_t BytesInChunk;
+	uint8_t i;
+	
+	if(DataloggerInitalized != 1)
+	{
+		return;
+	}
+	
+	TailPage = Datalogger_GetTail();
+	FullPages = Datalogger_PagesBetween(TailPage, DataPageAddress);
+	
+	//Give the page in the buffer a header so the host can decode it like the other pages
+	if(DataSetAddress > DATALOGGER_PAGE_HEADER_SIZE)
+	{
+		Datalogger_WriteHeader(BufferInUse);
+		LastPageBytes = DataSetAddress;
+	}
+	
+	//Frame header
+	Chunk[0] = DATALOGGER_DUMP_SYNC1;
+	Chunk[1] = DATALOGGER_DUMP_SYNC2;
+	Chunk[2] = DATALOGGER_DUMP_VERSION;
+	Chunk[3] = (uint8_t)(DataloggerPageSize >> 8);
+	Chunk[4] = (uint8_t)(DataloggerPageSize & 0xFF);
+	Chunk[5] = (uint8_t)(TailPage >> 8);
+	Chunk[6] = (uint8_t)(TailPage & 0xFF);
+	Chunk[7] = (uint8_t)(FullPages >> 8);
+	Chunk[8] = (uint8_t)(FullPages & 0xFF);
+	Chunk[9] = (uint8_t)(LastPageBytes >> 8);
+	Chunk[10] = (uint8_t)(LastPageBytes & 0xFF);
+	USBSerial_SendData(Chunk, 11);
+	
+	//Stream the full pages out of main memory with continuous reads. The rollup pages are after the log, so a new read is started at page 0 if the log wraps.
+	PageToRead = TailPage;
+	while(FullPages > 0)
+	{
+		PagesToRead = FullPages;
+		if((PageToRead + PagesToRead) > DataloggerLogPages)
+		{
+			PagesToRead = DataloggerLogPages - PageToRead;
+		}
+		BytesLeft = (uint32_t)PagesToRead * DataloggerPageSize;
+		
+		AT45DB321D_ContinuousReadStart(PageToRead, 0);
+		while(BytesLeft > 0)
+		{
+			BytesInChunk = sizeof(Chunk);
+			if(BytesLeft < BytesInChunk)
+			{
+				BytesInChunk = BytesLeft;
+			}
+			
+			AT45DB321D_ContinuousRead(Chunk, BytesInChunk);
+			for(i=0; i<BytesInChunk; i++)
+			{
+				CRCValue = _crc16_update(CRCValue, Chunk[i]);
+			}
+			USBSerial_SendData(Chunk, BytesInChunk);
+			BytesLeft -= BytesInChunk;
+		}
+		AT45DB321D_Deselect();
+		
+		FullPages -= PagesToRead;
+		PageToRead = 0;
+	}
+	
+	//The last page is still in the buffer
+	while(BufferAddress < LastPageBytes)
+	{
+		BytesInChunk = sizeof(Chunk);
+		if((LastPageBytes - BufferAddress) < BytesInChunk)
+		{
+			BytesInChunk = LastPageBytes - BufferAddress;
+		}
+		
+		AT45DB321D_BufferRead(BufferInUse, BufferAddress, Chunk, BytesInChunk);
+		for(i=0; i<BytesInChunk; i++)
+		{
+			CRCValue = _crc16_update(CRCValue, Chunk[i]);
+		}
+		USBSerial_SendData(Chunk, BytesInChunk);
+		BufferAddress += BytesInChunk;
+	}
+	
+	Chunk[0] = (uint8_t)(CRCValue >> 8);
+	Chunk[1] = (uint8_t)(CRCValue & 0xFF);
+	USBSerial_SendData(Chunk, 2);
+	USBSerial_Flush();
+	
+	return;
+}
+
+void Datalogger_ReadBackData(uint16_t NumberOfDataSets)
+{
+	uint16_t PageToLook;
+	uint16_t AddressToLook;
+	uint8_t ReadBuffer;
+	uint8_t RecordSize;
+	uint8_t Record;
+	uint8_t i;
+	
+	uint8_t TempVal[DATALOGGER_DATASET_SIZE];
+	DataloggerPageHeader Header;
+	
+	if((DataloggerInitalized != 1) || (NumberOfDataSets == 0))
+	{
+		return;
+	}
+	
+	//Start with the oldest page
+	PageToLook = Datalogger_GetTail();
+	
+	//printf_P(PSTR("Looking for data in page 0x%04X using buffer %u\n"), PageToLook, TempBuffer);
+	
+	while(1)
+	{
+		//The page being written is still in the buffer in use, the other pages are loaded into the other buffer
+		ReadBuffer = Datalogger_GetPageHeader(PageToLook, &Header);
+		if((ReadBuffer == 0) && (Header.RecordCount > 0))
+		{
+			ReadBuffer = AT45DB321D_CacheLoadPage(PageToLook);
+		}
+		
+		AddressToLook = DATALOGGER_PAGE_HEADER_SIZE;
+		for(Record=0; Record<Header.RecordCount; Record++)
+		{
+			RecordSize = Datalogger_ReadDataSet(ReadBuffer, PageToLook, AddressToLook, &Header, TempVal);
+			if(RecordSize == 0)
+			{
+				break;
+			}
+			
+			NumberOfDataSets--;
+			for(i=0; i<DATALOGGER_DATASET_SIZE; i++)
+			{
+				printf_P(PSTR("0x%02X, "), TempVal[i]);
+			}
+			printf_P(PSTR("\b\b \b\n"));
+			if(NumberOfDataSets == 0)
+			{
+				return;
+			}
+			AddressToLook += RecordSize;
+		}
+		
+		if(PageToLook == DataPageAddress)
+		{
+			break;
+		}
+		PageToLook = Datalogger_AddPages(PageToLook, 1);
+	}
 
 	return;
 }
 
 
-/** @} */
\ No newline at end of file
+/** @} */
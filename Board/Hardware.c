@@ -28,14 +28,35 @@
 #define HARDWARE_TIMER_0_TOP_VALUE	124
 
 //Global variables needed for the timer
-TimeAndDate TimerStartTime;
-volatile uint16_t TimerStartMS;
-volatile uint8_t TimerRemainder;
-volatile uint8_t TimerRunning;
+uint32_t TimerStartTick;
+uint8_t TimerRunning;
 
 //Global variables needed for the RTC
-TimeAndDate TheTime;
+//The time is kept as seconds since HARDWARE_EPOCH_YEAR, and only turned into a date when it is needed
+volatile uint32_t EpochSeconds;
 volatile uint16_t ElapsedMS;
+volatile uint32_t TickMS;		//Free running ms count for timeouts, it is not changed when the time is set
+
+//The sample in progress, see StartDataSet
+#define DATASET_STATE_IDLE			0
+#define DATASET_STATE_TEMP			1		//Waiting for the SHT25 temperature
+#define DATASET_STATE_RH			2		//Waiting for the SHT25 RH
+#define DATASET_CONVERSION_TIMEOUT_MS	250		//Longest wait for each SHT25 conversion
+static uint8_t SampleState;
+static uint32_t SampleTime;
+static uint32_t SamplePressureReady;		//Tick when the MPL115A1 conversion is done
+static uint8_t SamplePressureDone;
+static uint32_t SampleNextPoll;				//Tick to poll the SHT25 next
+static uint32_t SampleDeadline;				//Tick when the SHT25 conversion has timed out
+static int16_t SampleTemperature;
+static int16_t SampleRH;
+static int16_t SamplePressure;
+static uint16_t SampleLight[4];
+#if PROFILE_ENABLE == 1
+static uint32_t SampleStartFine;			//Fine tick when the sample was started, for PROFILE_GETDATASET
+#endif
+
+static void FillDataSet(uint8_t DataSet[]);
 
 
 
@@ -44,13 +65,8 @@ void HardwareInit( void )
 {
 	//Initalize variables
 	ElapsedMS		= 0x0000;
-	TheTime.sec		= 0;
-	TheTime.min		= 0;
-	TheTime.hour	= 0;
-	TheTime.dow		= 0;
-	TheTime.day		= 0;
-	TheTime.month	= 0;
-	TheTime.year	= 0;
+	TickMS			= 0;
+	EpochSeconds	= 0;
 	TimerRunning = 0;
 	
 	//Disable watchdog if enabled by bootloader/fuses
@@ -102,7 +118,7 @@ void HardwareInit( void )
 	PORTD	= 0x00;
 	
 	//Enable USB and interrupts
-	InitSPIMaster(0,0);
+	SPIInit();
 	I2CSoft_Init();
 	USB_Init();
 	
@@ -118,6 +134,13 @@ void HardwareInit( void )
 	return;
 }
 
+void SPIInit(void)
+{
+	InitSPIMaster(0,0);
+	SPSR |= (1<<SPI2X);		//Double speed, the SPI clock is F_CPU/2
+	return;
+}
+
 void LED(uint8_t LEDState)
 {
 	if(LEDState == 1)
@@ -131,188 +154,224 @@ void LED(uint8_t LEDState)
 	return;
 }
 
-void DelayMS(uint16_t ms)
+uint32_t GetTickMS(void)
 {
-	uint16_t WaitMS = 0;
-	
-	if(ms == 0) return;
+	uint32_t Tick;
 	
-	//Delay is too long, call delaySec?
-	if (ms >= 1000)
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
 	{
-		return;
+		Tick = TickMS;
 	}
+	return Tick;
+}
+
+uint32_t GetTickFine(void)
+{
+	uint32_t Tick;
+	uint8_t Count;
 	
-	//Look for milisecond overflow
-	if((ms + ElapsedMS) > 1000)
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
 	{
-		WaitMS = ms + ElapsedMS - 1001;
+		Tick = TickMS;
+		Count = TCNT0;
+		
+		//The counter may have restarted with the ms interrupt still waiting to run
+		if(((TIFR0 & (1<<OCF0A)) != 0) && (Count < (HARDWARE_TIMER_0_TOP_VALUE/2)))
+		{
+			Tick++;
+		}
 	}
-	else
+	return (Tick * (HARDWARE_TIMER_0_TOP_VALUE + 1)) + Count;
+}
+
+void DelayMS(uint16_t ms)
+{
+	uint32_t WakeTime;
+	
+	//The free running tick does not reset every second, so any length of delay works
+	WakeTime = GetTickMS() + ms;
+	while((int32_t)(GetTickMS() - WakeTime) < 0)
 	{
-		WaitMS = ms + ElapsedMS;
+		asm volatile ("nop");
 	}
+	return;
+}
+
+uint32_t GetEpochTime(uint16_t *MS)
+{
+	uint32_t Seconds;
 	
-	while (WaitMS != ElapsedMS)
+	//The seconds and ms change together in the timer interrupt
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
 	{
-		asm volatile ("nop");
+		Seconds = EpochSeconds;
+		if(MS != NULL)
+		{
+			*MS = ElapsedMS;
+		}
+	}
+	return Seconds;
+}
+
+void SetEpochTime(uint32_t Seconds)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		EpochSeconds = Seconds;
+		ElapsedMS = 0;
 	}
 	return;
 }
 
 void GetTime( TimeAndDate *TimeToReturn )
 {
-	TimeToReturn->year 	= 	TheTime.year;
-	TimeToReturn->month = 	TheTime.month;
-	TimeToReturn->day 	= 	TheTime.day;
-	TimeToReturn->dow 	= 	TheTime.dow;
-	TimeToReturn->hour 	= 	TheTime.hour;
-	TimeToReturn->min 	= 	TheTime.min;
-	TimeToReturn->sec 	= 	TheTime.sec;
+	EpochToTime(GetEpochTime(NULL), TimeToReturn);
 	return;
 }
 
 void SetTime( TimeAndDate TimeToSet )
 {
+	TimeAndDate NewTime;
 	uint8_t NumberOfDaysPerMonth;
 
+	//Fields that are out of range keep their current value
+	GetTime(&NewTime);
+	
 	//hour must be less than 24
 	if(TimeToSet.hour < 24)
 	{
-		TheTime.hour = TimeToSet.hour;
+		NewTime.hour = TimeToSet.hour;
 	}
 	
 	//minutes must be less than 60
 	if(TimeToSet.min < 60)
 	{
-		TheTime.min = TimeToSet.min;
+		NewTime.min = TimeToSet.min;
 	}
 	
 	//Seconds must be less than 60
 	if(TimeToSet.sec < 60)
 	{
-		TheTime.sec = TimeToSet.sec;
+		NewTime.sec = TimeToSet.sec;
 	}
 	
 	//months must be 1-12
 	if((TimeToSet.month > 0) && (TimeToSet.month < 13))
 	{
-		TheTime.month = TimeToSet.month;
+		NewTime.month = TimeToSet.month;
 	}
 	
-	//day of the week must be 1-7
-	if((TimeToSet.dow > 0) && (TimeToSet.dow < 8))
+	//The year must fit in the epoch count. The day of the week comes from the date.
+	if(TimeToSet.year < 100)
 	{
-		TheTime.dow = TimeToSet.dow;
+		TimeToSet.year += HARDWARE_EPOCH_YEAR;
 	}
-	
-	//Year cannot be zero
-	if(TimeToSet.year != 0)
+	if((TimeToSet.year >= HARDWARE_EPOCH_YEAR) && (TimeToSet.year <= HARDWARE_EPOCH_LAST_YEAR))
 	{
-		TheTime.year = TimeToSet.year;
+		NewTime.year = TimeToSet.year;
 	}
 	
 	//Check for leap year, and determine how many days per month.
-	if(TheTime.month == 4)
+	NumberOfDaysPerMonth = DaysPerMonth(NewTime.month);
+	if((NewTime.month == 2) && (IsLeapYear(NewTime.year) == 1))
 	{
-		if(IsLeapYear(TheTime.year) == 1)
-		{
-			NumberOfDaysPerMonth = 29;
-		}
-		else
-		{
-			NumberOfDaysPerMonth = 28;
-		}
-	}
-	else
-	{
-		NumberOfDaysPerMonth = DaysPerMonth(TheTime.month);
+		NumberOfDaysPerMonth = 29;
 	}
 	
-	//days must be valid
 	if((TimeToSet.day > 0) && (TimeToSet.day < (NumberOfDaysPerMonth + 1)))
 	{
-		TheTime.day = TimeToSet.day;
+		NewTime.day = TimeToSet.day;
+	}
+	else if(NewTime.day > NumberOfDaysPerMonth)
+	{
+		//The old day does not fit in the new month
+		NewTime.day = NumberOfDaysPerMonth;
 	}
+	
+	SetEpochTime(TimeToEpoch(&NewTime));
+	return;
+}
 
+void EpochToTime(uint32_t Seconds, TimeAndDate *Time)
+{
+	uint16_t Days;
+	uint16_t DaysInYear;
+	uint8_t DaysInMonth;
+	
+	Time->sec = Seconds % 60;
+	Seconds = Seconds / 60;
+	Time->min = Seconds % 60;
+	Seconds = Seconds / 60;
+	Time->hour = Seconds % 24;
+	Days = Seconds / 24;
+	
+	//The first day of the epoch is a Saturday
+	Time->dow = ((Days + HARDWARE_EPOCH_DOW - 1) % 7) + 1;
+	
+	Time->year = HARDWARE_EPOCH_YEAR;
+	DaysInYear = 365 + IsLeapYear(Time->year);
+	while(Days >= DaysInYear)
+	{
+		Days -= DaysInYear;
+		Time->year++;
+		DaysInYear = 365 + IsLeapYear(Time->year);
+	}
+	
+	Time->month = 1;
+	DaysInMonth = DaysPerMonth(Time->month);
+	while(Days >= DaysInMonth)
+	{
+		Days -= DaysInMonth;
+		Time->month++;
+		DaysInMonth = DaysPerMonth(Time->month);
+		if(Time->month == 2)
+		{
+			DaysInMonth += IsLeapYear(Time->year);
+		}
+	}
+	Time->day = Days + 1;
 	return;
 }
 
+uint32_t TimeToEpoch(TimeAndDate *Time)
+{
+	uint16_t Days = 0;
+	uint16_t Year;
+	uint8_t Month;
+	
+	for(Year = HARDWARE_EPOCH_YEAR; Year < Time->year; Year++)
+	{
+		Days += 365 + IsLeapYear(Year);
+	}
+	for(Month = 1; Month < Time->month; Month++)
+	{
+		Days += DaysPerMonth(Month);
+		if(Month == 2)
+		{
+			Days += IsLeapYear(Time->year);
+		}
+	}
+	Days += Time->day - 1;
+	
+	return ((((uint32_t)Days * 24 + Time->hour) * 60 + Time->min) * 60) + Time->sec;
+}
+
 void StartTimer(void)
 {
-	TimerStartTime.day = TheTime.day;
-	TimerStartTime.hour = TheTime.hour;
-	TimerStartTime.min = TheTime.min;
-	TimerStartTime.sec = TheTime.sec;
-	TimerStartMS = ElapsedMS;
-	TimerRemainder = TCNT0;
+	TimerStartTick = GetTickFine();
 	TimerRunning = 1;
-
 	return;
 }
 
-
 void StopTimer(void)
 {
-	//TODO: add a check to see if the timer is running.
-	TimeAndDate TimerEndTime;
-	uint8_t TimerEndRemainder = 0;
-	uint16_t ElapsedUS;
-	uint16_t TimerEndMS;
+	uint32_t Elapsed;
 	
 	if(TimerRunning == 1)
 	{
-		//Get final timer value
-		TimerEndTime.day = TheTime.day;
-		TimerEndTime.hour = TheTime.hour;
-		TimerEndTime.min = TheTime.min;
-		TimerEndTime.sec = TheTime.sec;
-		TimerEndMS = ElapsedMS;
-		TimerEndRemainder = TCNT0;
-		
-		
-		
-		printf_P(PSTR("Time: %02u sec %04u ms %04u us\n"), TimerEndTime.sec-TimerStartTime.sec, TimerEndMS-TimerStartMS , (HARDWARE_TIMER_0_TOP_VALUE - TimerRemainder) + TimerEndRemainder);
-		
-		
-		
-		
-		
-		
-		
-		//TimerEndMS
-		//ElapsedUS = (HARDWARE_TIMER_0_TOP_VALUE - TimerRemainder) + TimerEndRemainder;
-		//if(ElapsedUS > 1000)
-		//{
-		//	ElapsedUS = ElapsedUS - 1000;
-		//}
-		
-		/*if(TimerEndTime.day != TimerStartTime.day)
-		{
-			TimerEndTime.day = TimerEndTime.day - TimerStartTime.day;
-			TimerEndTime.hour = TimerEndTime.hour + (24 - TimerStartTime.hour);
-			TimerEndTime.min = TimerEndTime.min + (60 - TimerStartTime.min);
-			TimerEndTime.sec = TimerEndTime.sec + (60 - TimerStartTime.sec);
-		}
-		
-		if(
-		
-		
-		
-		
-		
-			if(TimerEndTime.hour = TimerStartTime.hour)
-			{
-				if(TimerEndTime.min = TimerStartTime.min)
-				{
-					if(TimerEndTime.sec = TimerStartTime.sec)
-					{
-					
-					}*/
-		
-		
-		
-		//Reset the timer value
+		//The fine tick does not reset with the time, so this works across second and minute boundaries
+		Elapsed = GetTickFine() - TimerStartTick;
+		printf_P(PSTR("Time: %lu ms %03u us\n"), Elapsed/(1000/TICK_FINE_US), (uint16_t)(Elapsed%(1000/TICK_FINE_US))*TICK_FINE_US);
 		TimerRunning = 0;
 	}
 	return;
@@ -320,97 +379,173 @@ void StopTimer(void)
 
 uint8_t GetDataSet(uint8_t DataSet[])
 {
-	uint16_t LS_Data[4];
-	TimeAndDate CurrentTime;
-	int16_t Pressure_kPa;
-	int16_t TemperatureData;
-	int16_t RHData;
 	uint8_t stat;
 	
-	GetTime(&CurrentTime);
-	//printf_P(PSTR("%02u Days %02u:%02u:%02u\n"), CurrentTime.day, CurrentTime.hour, CurrentTime.min, CurrentTime.sec);
+	stat = StartDataSet();
+	while(stat == DATASET_STATUS_BUSY)
+	{
+		stat = PollDataSet(DataSet);
+	}
+	return stat;
+}
+
+uint8_t StartDataSet(void)
+{
+	uint32_t Now;
 	
-	//Read temperature
-	stat = SHT25_ReadTemp(&TemperatureData);
-	if(stat == SHT25_RETURN_STATUS_OK)
+	//Do not clobber the sample in progress
+	if(SampleState != DATASET_STATE_IDLE)
 	{
-		//printf_P(PSTR("Temp %d.%02u C\n"), TemperatureData/100, TemperatureData%100);
+		return DATASET_STATUS_IN_USE;
 	}
-	else if(stat == SHT25_RETURN_STATUS_CRC_ERROR)
+	
+	//All of the readings are taken within a few ms of this time
+	SampleTime = GetEpochTime(NULL);
+#if PROFILE_ENABLE == 1
+	SampleStartFine = GetTickFine();
+#endif
+	Now = GetTickMS();
+	
+	//Start the two slow conversions. The SHT25 is on the soft I2C bus and the MPL115A1 is on SPI, so they run at the same time.
+	if(SHT25_StartTemp() != SOFT_I2C_STAT_OK)
+	{
+		SampleState = DATASET_STATE_IDLE;
+		return DATASET_STATUS_TIMEOUT;
+	}
+	MPL115A1_StartConversion();
+	SamplePressureReady = Now + MPL115A1_CONVERSION_MS;
+	SamplePressureDone = 0;
+	
+	SampleState = DATASET_STATE_TEMP;
+	SampleNextPoll = Now + SHT25_TEMP_TYPICAL_MS;
+	SampleDeadline = Now + DATASET_CONVERSION_TIMEOUT_MS;
+	
+	//The TCS3414 integrates all the time, so its last result is read while the others convert.
+	//The SHT25 does not answer its address during a conversion, so this does not disturb it.
+	if(tcs3414_GetData(&SampleLight[0], &SampleLight[1], &SampleLight[2], &SampleLight[3]) != 0)
+	{
+		SampleState = DATASET_STATE_IDLE;
+		return DATASET_STATUS_ERROR;
+	}
+	return DATASET_STATUS_BUSY;
+}
+
+uint8_t DataSetBusy(void)
+{
+	if(SampleState != DATASET_STATE_IDLE)
 	{
-		//printf_P(PSTR("CRC Error\n"));
 		return 1;
 	}
-	else
+	return 0;
+}
+
+uint8_t PollDataSet(uint8_t DataSet[])
+{
+	uint32_t Now;
+	uint16_t Padc;
+	uint16_t Tadc;
+	uint8_t stat;
+	
+	if(SampleState == DATASET_STATE_IDLE)
 	{
-		//printf_P(PSTR("Timeout\n"));
-		return 2;
+		return DATASET_STATUS_ERROR;
 	}
 	
-	//Read RH
-	stat = SHT25_ReadRH(&RHData);
-	if(stat == SHT25_RETURN_STATUS_OK)
+	Now = GetTickMS();
+	
+	//Pressure is done long before the SHT25
+	if((SamplePressureDone == 0) && ((int32_t)(Now - SamplePressureReady) >= 0))
 	{
-		//printf_P(PSTR("RH: %u.%02u%%\n"), RHData/100, RHData%100);
+		MPL115A1_ReadConversion(&Padc, &Tadc);
+		SamplePressure = MPL115A1_CompensatePressure(Padc, Tadc);
+		SamplePressureDone = 1;
 	}
-	else if(stat == SHT25_RETURN_STATUS_CRC_ERROR)
+	
+	if((int32_t)(Now - SampleNextPoll) < 0)
 	{
-		//printf_P(PSTR("CRC Error\n"));
-		return 1;
+		return DATASET_STATUS_BUSY;
+	}
+	
+	if(SampleState == DATASET_STATE_TEMP)
+	{
+		stat = SHT25_GetTemp(&SampleTemperature);
+		if(stat == SHT25_RETURN_STATUS_OK)
+		{
+			//The SHT25 has one ADC, RH can only start once the temperature is read
+			if(SHT25_StartRH() != SOFT_I2C_STAT_OK)
+			{
+				SampleState = DATASET_STATE_IDLE;
+				return DATASET_STATUS_TIMEOUT;
+			}
+			SampleState = DATASET_STATE_RH;
+			SampleNextPoll = Now + SHT25_RH_TYPICAL_MS;
+			SampleDeadline = Now + DATASET_CONVERSION_TIMEOUT_MS;
+			return DATASET_STATUS_BUSY;
+		}
 	}
 	else
 	{
-		//printf_P(PSTR("Timeout\n"));
-		return 2;
+		stat = SHT25_GetRH(&SampleRH);
+		if((stat == SHT25_RETURN_STATUS_OK) && (SamplePressureDone == 1))
+		{
+			SampleState = DATASET_STATE_IDLE;
+			FillDataSet(DataSet);
+			PROFILE_STOP(PROFILE_GETDATASET, SampleStartFine);
+			return DATASET_STATUS_OK;
+		}
+		else if(stat == SHT25_RETURN_STATUS_OK)
+		{
+			//Can only happen if the RH came back within MPL115A1_CONVERSION_MS of the start
+			return DATASET_STATUS_BUSY;
+		}
 	}
 	
-	//Current barometric pressure
-	//TODO: add check for pressure...
-	MPL115A1_GetPressure(&Pressure_kPa);
-	//(PSTR("Pressure: %u.%u kPa\n"), ((int16_t)Pressure_kPa)>>4, ((((int16_t)Pressure_kPa)&0x000F)*1000)/(16) );
+	if(stat == SHT25_RETURN_STATUS_CRC_ERROR)
+	{
+		SampleState = DATASET_STATE_IDLE;
+		return DATASET_STATUS_ERROR;
+	}
 	
-	if(tcs3414_GetData(&LS_Data[0], &LS_Data[1], &LS_Data[2], &LS_Data[3]) != 0)
+	//Still converting
+	if((int32_t)(Now - SampleDeadline) >= 0)
 	{
-		return 1;
-		//printf_P(PSTR("red:	0x%04X\n"), LS_Data[0]);
-		//printf_P(PSTR("green:	0x%04X\n"), LS_Data[1]);
-		//printf_P(PSTR("blue:	0x%04X\n"), LS_Data[2]);
-		//printf_P(PSTR("clear:	0x%04X\n"), LS_Data[3]);
-	}
-	//else
-	//{
-	//	return 1;
-	//}
-	
-	//Time data
-	DataSet[0] = CurrentTime.month;
-	DataSet[1] = CurrentTime.day;
-	DataSet[2] = CurrentTime.hour;
-	DataSet[3] = CurrentTime.min;
+		SampleState = DATASET_STATE_IDLE;
+		return DATASET_STATUS_TIMEOUT;
+	}
+	SampleNextPoll = Now + SHT25_FAST_POLL_MS;
+	return DATASET_STATUS_BUSY;
+}
+
+static void FillDataSet(uint8_t DataSet[])
+{
+	//Time data, seconds since HARDWARE_EPOCH_YEAR
+	DataSet[0] = (uint8_t)(SampleTime >> 24);
+	DataSet[1] = (uint8_t)(SampleTime >> 16);
+	DataSet[2] = (uint8_t)(SampleTime >> 8);
+	DataSet[3] = (uint8_t)(SampleTime & 0xFF);
 	
 	//Temperature
-	DataSet[4] = (uint8_t)((TemperatureData & 0xFF00) >> 8);
-	DataSet[5] = (uint8_t)(TemperatureData & 0xFF);
+	DataSet[4] = (uint8_t)((SampleTemperature & 0xFF00) >> 8);
+	DataSet[5] = (uint8_t)(SampleTemperature & 0xFF);
 	
 	//Humidity
-	DataSet[6] = (uint8_t)((RHData & 0xFF00) >> 8);
-	DataSet[7] = (uint8_t)(RHData & 0xFF);
+	DataSet[6] = (uint8_t)((SampleRH & 0xFF00) >> 8);
+	DataSet[7] = (uint8_t)(SampleRH & 0xFF);
 	
 	//Pressure
-	DataSet[8] = (uint8_t)((Pressure_kPa & 0xFF00) >> 8);
-	DataSet[9] = (uint8_t)(Pressure_kPa & 0xFF);
+	DataSet[8] = (uint8_t)((SamplePressure & 0xFF00) >> 8);
+	DataSet[9] = (uint8_t)(SamplePressure & 0xFF);
 	
 	//Color
-	DataSet[10] = (uint8_t)(((LS_Data[0]) & 0xFF00) >> 8);
-	DataSet[11] = (uint8_t)((LS_Data[0]) & 0xFF);
-	DataSet[12] = (uint8_t)(((LS_Data[1]) & 0xFF00) >> 8);
-	DataSet[13] = (uint8_t)((LS_Data[1]) & 0xFF);
-	DataSet[14] = (uint8_t)(((LS_Data[2]) & 0xFF00) >> 8);
-	DataSet[15] = (uint8_t)((LS_Data[2]) & 0xFF);
-	DataSet[16] = (uint8_t)(((LS_Data[3]) & 0xFF00) >> 8);
-	DataSet[17] = (uint8_t)((LS_Data[3]) & 0xFF);
-
-	return 0;
+	DataSet[10] = (uint8_t)(((SampleLight[0]) & 0xFF00) >> 8);
+	DataSet[11] = (uint8_t)((SampleLight[0]) & 0xFF);
+	DataSet[12] = (uint8_t)(((SampleLight[1]) & 0xFF00) >> 8);
+	DataSet[13] = (uint8_t)((SampleLight[1]) & 0xFF);
+	DataSet[14] = (uint8_t)(((SampleLight[2]) & 0xFF00) >> 8);
+	DataSet[15] = (uint8_t)((SampleLight[2]) & 0xFF);
+	DataSet[16] = (uint8_t)(((SampleLight[3]) & 0xFF00) >> 8);
+	DataSet[17] = (uint8_t)((SampleLight[3]) & 0xFF);
+	return;
 }
 
 
@@ -425,7 +560,7 @@ uint8_t DaysPerMonth(uint8_t MonthNumber)
 	{
 		return 28;
 	}
-	else if((MonthNumber == 4) ||(MonthNumber == 6) ||(MonthNumber == 9) ||(MonthNumber == 12))
+	else if((MonthNumber == 4) ||(MonthNumber == 6) ||(MonthNumber == 9) ||(MonthNumber == 11))
 	{
 		return 30;
 	}
@@ -463,71 +598,15 @@ uint8_t IsLeapYear(uint16_t TheYear)
 //Timer interrupt 0 for basic timing stuff
 ISR(TIMER0_COMPA_vect)
 {
-	uint16_t inByte;
 	ElapsedMS++;
-	uint8_t DPM;
+	TickMS++;
 	
-	//Handle USB stuff
-	//This happens every ~8 ms
-	if( ((ElapsedMS & 0x0007) == 0x0000) )
-	{
-		//receive and process a character from the USB CDC interface
-		inByte = CDC_Device_ReceiveByte(&VirtualSerial_CDC_Interface);
-		if((inByte > 0) && (inByte < 255))
-		{
-			CommandGetInputChar(inByte);	//NOTE: this limits the device to recieve a single character every 8ms (I think). This should not be a problem for user input.
-		}
-		
-		CDC_Device_USBTask(&VirtualSerial_CDC_Interface);
-		USB_USBTask();
-	}
+	//USB is serviced from the start of frame interrupt, see USBSerial_Service
 	
 	if(ElapsedMS >= 1000)
 	{
 		ElapsedMS = 0;
-		TheTime.sec += 1;
-		if(TheTime.sec > 59)
-		{
-			TheTime.sec = 0;
-			TheTime.min += 1;
-			if(TheTime.min > 59)
-			{
-				TheTime.min = 0;
-				TheTime.hour += 1;
-				if(TheTime.hour > 24)
-				{
-					TheTime.hour = 0;
-					TheTime.day += 1;
-					
-					//Determine the number of days in the month.
-					if(TheTime.month == 2)
-					{
-						if(IsLeapYear(TheTime.year) == 1)
-						{
-							DPM = 29;
-						}
-						else
-						{
-							DPM = 28;
-						}
-					}
-					else
-					{
-						DPM = DaysPerMonth(TheTime.month);
-					}
-					if(TheTime.day > DPM)
-					{
-						TheTime.day = 0;
-						TheTime.month += 1;
-						if(TheTime.month > 12)
-						{
-							TheTime.month = 0;
-							TheTime.year += 1;
-						}
-					}
-				}
-			}
-		}
+		EpochSeconds++;
 	}
 }
 
@@ -34,26 +34,93 @@
 */
 void HardwareInit( void );
 
+/** Wait for 'ms' milliseconds. Nothing else runs in the main loop while this waits, so it is only meant for startup code.
+ *	Tasks run by the scheduler should use SCHEDULER_TASK_SLEEP instead.
+ */
 void DelayMS(uint16_t ms);
+
+/** Returns the number of ms since the hardware was initalized. The count wraps after about 49 days, so compare two ticks by subtracting them. */
+uint32_t GetTickMS(void);
+
+#define TICK_FINE_US			8		//Length of a fine tick in us
+
+/** Returns the time since the hardware was initalized in fine ticks, from the ms count and the timer 0 count.
+ *	The count wraps after about 9 hours, so only use it to time short sections of code.
+ */
+uint32_t GetTickFine(void);
 //void DelaySEC(uint16_t SEC);
+
+//The real time clock counts seconds from the start of this year
+#define HARDWARE_EPOCH_YEAR			2000
+#define HARDWARE_EPOCH_LAST_YEAR	2135		//The last year that fits in the 32-bit count
+#define HARDWARE_EPOCH_DOW			7			//Day of the week of 1/1/2000, Sunday is 1
+
+/** Returns the time in seconds since the start of HARDWARE_EPOCH_YEAR. If 'MS' is not NULL, it is set to the ms into the second. */
+uint32_t GetEpochTime(uint16_t *MS);
+
+/** Set the time in seconds since the start of HARDWARE_EPOCH_YEAR. The ms count starts over. */
+void SetEpochTime(uint32_t Seconds);
+
+/** Get the time as a date. The day of the week is 1-7, with Sunday as 1. */
 void GetTime( TimeAndDate *time );
+
+/** Set the time from a date. Fields that are out of range are not changed. A year of 0-99 is taken as 2000-2099. The day of the week is worked out from the date. */
 void SetTime( TimeAndDate time );
 
+/** Convert seconds since the start of HARDWARE_EPOCH_YEAR to a date */
+void EpochToTime(uint32_t Seconds, TimeAndDate *Time);
 
+/** Convert a date to seconds since the start of HARDWARE_EPOCH_YEAR. The date is not checked, and the day of the week is not used. */
+uint32_t TimeToEpoch(TimeAndDate *Time);
+
+
+/** Start the timer used by StopTimer */
 void StartTimer(void);
+
+/** Print the time since StartTimer was called, to 8 us */
 void StopTimer(void);
 /*void RestartTimer(uint16_t *FinalMS, uint16_t *FinalSEC);*/
 
 void LED(uint8_t LEDState);
 
+/** Set the SPI to mode 0,0 at F_CPU/2. The dataflash and the pressure sensor both use this mode.
+ *	Use this instead of InitSPIMaster, which does not set the double speed bit.
+ */
+void SPIInit(void);
+
 //Returns 1 if the year is a leap year
 uint8_t IsLeapYear(uint16_t TheYear);
 
 //Returns the number of days in the month. Will always return 28 for february, aditional checks will be needed to correct for leap years.
 uint8_t DaysPerMonth(uint8_t MonthNumber);
 
+//Return values for GetDataSet, StartDataSet and PollDataSet
+#define DATASET_STATUS_OK			0
+#define DATASET_STATUS_ERROR		1		//CRC error or the light sensor did not answer
+#define DATASET_STATUS_TIMEOUT		2		//The SHT25 did not answer
+#define DATASET_STATUS_BUSY			3		//The sample is not done yet
+#define DATASET_STATUS_IN_USE		4		//Another sample is in progress, nothing was started
+
+/** Take a sample of all the sensors and put it in DataSet, which must hold DATALOGGER_DATASET_SIZE bytes.
+ *	This is StartDataSet followed by PollDataSet until the sample is done. It takes about as long as the two SHT25 conversions,
+ *	and nothing else in the main loop runs while it waits. Sampler_Task and the data command use StartDataSet and PollDataSet instead.
+ */
 uint8_t GetDataSet(uint8_t DataSet[]);
 
+/** Start a sample and return without waiting for the conversions.
+ *	The time is taken, the SHT25 temperature and MPL115A1 conversions are started, and the TCS3414 is read while they run.
+ *	Returns DATASET_STATUS_BUSY if the sample was started, DATASET_STATUS_IN_USE if a sample is already in progress, or an error.
+ */
+uint8_t StartDataSet(void);
+
+/** Collect the results of the sample started by StartDataSet as each sensor finishes. The SHT25 RH conversion is started when the temperature is read.
+ *	Returns DATASET_STATUS_BUSY until the sample is done, then fills in DataSet and returns DATASET_STATUS_OK, or returns an error.
+ */
+uint8_t PollDataSet(uint8_t DataSet[]);
+
+/** Returns 1 if a sample has been started and is not done yet. Only one sample can be in progress, the sensors and the sample state are shared. */
+uint8_t DataSetBusy(void);
+
 #endif
 
 /** @} */
@@ -25,9 +25,231 @@
 
 #include "main.h"
 
+//Busy tracking. The operations that take the device busy record a deadline, and the next command that needs the device waits for it.
+uint8_t AT45DB321D_Busy;			//Set to 1 while an operation started by the driver may still be running
+uint8_t AT45DB321D_BusyBuffer;		//The buffer used by that operation, 0 if it only uses main memory
+uint32_t AT45DB321D_BusyDeadline;	//The tick by which the operation must be done
+
+//Geometry of the part that is fitted. These start out as the AT45DB321D values and are updated from the device ID.
+uint16_t AT45DB321D_PageCount = AT45DB321D_DEFAULT_PAGE_COUNT;
+uint16_t AT45DB321D_PageSize = AT45DB321D_PAGE_SIZE_BYTES;
+uint16_t AT45DB321D_PagesPerSector = AT45DB321D_PAGES_PER_SECTOR;
+uint8_t AT45DB321D_AddressShift = AT45DB321D_DEFAULT_ADDRESS_SHIFT;
+
+//Buffer cache. The two SRAM buffers are treated as a cache of main memory pages.
+uint16_t AT45DB321D_BufferPage[2];		//The page each buffer holds, AT45DB321D_NO_PAGE if it is not known
+uint8_t AT45DB321D_BufferDirty[2];		//Set to 1 if the buffer has data that is not in main memory
+uint8_t AT45DB321D_BufferLastUsed;		//The buffer that was used most recently
+
+static void AT45DB321D_SetBusy(uint8_t Buffer, uint32_t TimeoutMS);
+static void AT45DB321D_WaitIfBusy(uint8_t Buffer);
+static void AT45DB321D_CacheErased(uint16_t FirstPage, uint16_t Pages);
+static void AT45DB321D_CacheProgrammed(uint8_t Buffer, uint16_t PageAddress);
+
 void AT45DB321D_Init(void)
 {
 	AT45DB321D_Deselect();
+	AT45DB321D_Busy = 0;
+	AT45DB321D_BusyBuffer = 0;
+	AT45DB321D_CacheInvalidate();
+	
+	if(AT45DB321D_ReadGeometry() == 0)
+	{
+		printf_P(PSTR("Unknown dataflash, using AT45DB321D geometry\n"));
+	}
+	return;
+}
+
+uint8_t AT45DB321D_ReadGeometry(void)
+{
+	uint8_t ID[2];
+	uint8_t StatusByte;
+	uint16_t BinaryPageSize;
+	
+	AT45DB321D_WaitIfBusy(0);
+	AT45DB321D_Select();
+	SPISendByte(AT45DB321D_CMD_READ_DEVICE_ID);
+	ID[0] = SPISendByte(0x00);
+	ID[1] = SPISendByte(0x00);
+	AT45DB321D_Deselect();
+	
+	//Byte 1 is the manufacturer, the top 3 bits of byte 2 are the family and the bottom 5 bits are the density
+	if((ID[0] != AT45DB321D_MANUFACTURER_ATMEL) || ((ID[1] & 0xE0) != AT45DB321D_FAMILY_DATAFLASH))
+	{
+		return 0;
+	}
+	
+	//Page counts and sizes from the datasheets, the size is the power of 2 size.
+	switch(ID[1] & 0x1F)
+	{
+		case AT45DB321D_DENSITY_4MBIT:
+			AT45DB321D_PageCount = 2048;
+			BinaryPageSize = 256;
+			AT45DB321D_PagesPerSector = 256;
+			break;
+		case AT45DB321D_DENSITY_8MBIT:
+			AT45DB321D_PageCount = 4096;
+			BinaryPageSize = 256;
+			AT45DB321D_PagesPerSector = 256;
+			break;
+		case AT45DB321D_DENSITY_16MBIT:
+			AT45DB321D_PageCount = 4096;
+			BinaryPageSize = 512;
+			AT45DB321D_PagesPerSector = 256;
+			break;
+		case AT45DB321D_DENSITY_32MBIT:
+			AT45DB321D_PageCount = 8192;
+			BinaryPageSize = 512;
+			AT45DB321D_PagesPerSector = 128;
+			break;
+		case AT45DB321D_DENSITY_64MBIT:
+			AT45DB321D_PageCount = 8192;
+			BinaryPageSize = 1024;
+			AT45DB321D_PagesPerSector = 256;
+			break;
+		default:
+			return 0;
+	}
+	
+	//The page address goes above the byte address. The byte address needs one more bit for the 264/528/1056 byte pages.
+	AT45DB321D_AddressShift = 0;
+	while((1U << AT45DB321D_AddressShift) < BinaryPageSize)
+	{
+		AT45DB321D_AddressShift++;
+	}
+	StatusByte = AT45DB321D_ReadStatus();
+	if((StatusByte & AT45DB321D_STATUS_PAGE_SIZE_MASK) != 0)
+	{
+		AT45DB321D_PageSize = BinaryPageSize;
+	}
+	else
+	{
+		AT45DB321D_PageSize = BinaryPageSize + (BinaryPageSize >> 5);
+		AT45DB321D_AddressShift++;
+	}
+	return 1;
+}
+
+uint16_t AT45DB321D_GetPageCount(void)
+{
+	return AT45DB321D_PageCount;
+}
+
+uint16_t AT45DB321D_GetPageSize(void)
+{
+	return AT45DB321D_PageSize;
+}
+
+uint16_t AT45DB321D_GetPagesPerSector(void)
+{
+	return AT45DB321D_PagesPerSector;
+}
+
+uint8_t AT45DB321D_GetAddressShift(void)
+{
+	return AT45DB321D_AddressShift;
+}
+
+uint8_t AT45DB321D_CacheFindPage(uint16_t PageAddress)
+{
+	uint8_t i;
+	
+	for(i=0; i<2; i++)
+	{
+		if(AT45DB321D_BufferPage[i] == PageAddress)
+		{
+			AT45DB321D_BufferLastUsed = i+1;
+			return i+1;
+		}
+	}
+	return 0;
+}
+
+uint8_t AT45DB321D_CacheLoadPage(uint16_t PageAddress)
+{
+	uint8_t Buffer;
+	
+	Buffer = AT45DB321D_CacheFindPage(PageAddress);
+	if(Buffer != 0)
+	{
+		return Buffer;
+	}
+	
+	//Replace the least recently used buffer. Buffers with data that is not in main memory are never replaced.
+	if(AT45DB321D_BufferLastUsed == 1)
+	{
+		Buffer = 2;
+	}
+	else
+	{
+		Buffer = 1;
+	}
+	if(AT45DB321D_BufferDirty[Buffer-1] != 0)
+	{
+		Buffer = 3 - Buffer;
+		if(AT45DB321D_BufferDirty[Buffer-1] != 0)
+		{
+			return 0;
+		}
+	}
+	
+	AT45DB321D_CopyPageToBuffer(Buffer, PageAddress);
+	return Buffer;
+}
+
+void AT45DB321D_CacheSetPage(uint8_t Buffer, uint16_t PageAddress)
+{
+	if( (Buffer != 1) && (Buffer != 2) )
+	{
+		return;
+	}
+	
+	//The other buffer can not hold the same page, one of the two would be out of date
+	if(AT45DB321D_BufferPage[2-Buffer] == PageAddress)
+	{
+		AT45DB321D_BufferPage[2-Buffer] = AT45DB321D_NO_PAGE;
+	}
+	AT45DB321D_BufferPage[Buffer-1] = PageAddress;
+	AT45DB321D_BufferDirty[Buffer-1] = 1;
+	AT45DB321D_BufferLastUsed = Buffer;
+	return;
+}
+
+void AT45DB321D_CacheInvalidate(void)
+{
+	AT45DB321D_BufferPage[0] = AT45DB321D_NO_PAGE;
+	AT45DB321D_BufferPage[1] = AT45DB321D_NO_PAGE;
+	AT45DB321D_BufferDirty[0] = 0;
+	AT45DB321D_BufferDirty[1] = 0;
+	AT45DB321D_BufferLastUsed = 1;
+	return;
+}
+
+//After a buffer is written to a page, the buffer matches the page. A copy of the page in the other buffer is now out of date.
+static void AT45DB321D_CacheProgrammed(uint8_t Buffer, uint16_t PageAddress)
+{
+	if(AT45DB321D_BufferPage[2-Buffer] == PageAddress)
+	{
+		AT45DB321D_BufferPage[2-Buffer] = AT45DB321D_NO_PAGE;
+		AT45DB321D_BufferDirty[2-Buffer] = 0;
+	}
+	AT45DB321D_BufferPage[Buffer-1] = PageAddress;
+	AT45DB321D_BufferDirty[Buffer-1] = 0;
+	return;
+}
+
+//Forget a buffer that holds a copy of a page that was just erased. Buffers with data that is not in main memory yet are kept.
+static void AT45DB321D_CacheErased(uint16_t FirstPage, uint16_t Pages)
+{
+	uint8_t i;
+	
+	for(i=0; i<2; i++)
+	{
+		if((AT45DB321D_BufferDirty[i] == 0) && (AT45DB321D_BufferPage[i] != AT45DB321D_NO_PAGE) && ((uint16_t)(AT45DB321D_BufferPage[i] - FirstPage) < Pages))
+		{
+			AT45DB321D_BufferPage[i] = AT45DB321D_NO_PAGE;
+		}
+	}
 	return;
 }
 
@@ -43,6 +265,80 @@ void AT45DB321D_Deselect(void)
 	return;
 }
 
+//Pipelined SPI transfers. At F_CPU/2 a byte takes 16 cycles, so the next byte is started as soon as the last one is done.
+//The received byte is stored before the next transfer is started. If it were stored after, an interrupt between the two would let
+//the next byte overwrite it. Interrupts can only delay these loops, they never lose or repeat a byte.
+#define AT45DB321D_READ_NEXT()		do { while((SPSR & (1<<SPIF)) == 0); *Data++ = SPDR; SPDR = 0x00; } while(0)
+#define AT45DB321D_WRITE_NEXT()		do { NextByte = *Data++; while((SPSR & (1<<SPIF)) == 0); SPDR = NextByte; } while(0)
+
+void AT45DB321D_ReadBlock(uint8_t Data[], uint16_t Bytes)
+{
+	if(Bytes == 0)
+	{
+		return;
+	}
+	
+	SPDR = 0x00;
+	Bytes--;
+	while(Bytes >= 4)
+	{
+		AT45DB321D_READ_NEXT();
+		AT45DB321D_READ_NEXT();
+		AT45DB321D_READ_NEXT();
+		AT45DB321D_READ_NEXT();
+		Bytes -= 4;
+	}
+	while(Bytes > 0)
+	{
+		AT45DB321D_READ_NEXT();
+		Bytes--;
+	}
+	while((SPSR & (1<<SPIF)) == 0);
+	*Data = SPDR;
+	return;
+}
+
+void AT45DB321D_WriteBlock(uint8_t Data[], uint16_t Bytes)
+{
+	uint8_t NextByte;
+	
+	if(Bytes == 0)
+	{
+		return;
+	}
+	
+	SPDR = *Data++;
+	Bytes--;
+	while(Bytes >= 4)
+	{
+		AT45DB321D_WRITE_NEXT();
+		AT45DB321D_WRITE_NEXT();
+		AT45DB321D_WRITE_NEXT();
+		AT45DB321D_WRITE_NEXT();
+		Bytes -= 4;
+	}
+	while(Bytes > 0)
+	{
+		AT45DB321D_WRITE_NEXT();
+		Bytes--;
+	}
+	
+	//Wait for the last byte before the device can be deselected. Reading SPDR clears SPIF.
+	while((SPSR & (1<<SPIF)) == 0);
+	NextByte = SPDR;
+	return;
+}
+
+void AT45DB321D_SendCommand(uint8_t Opcode, uint16_t PageAddress, uint16_t ByteAddress, uint8_t DummyBytes)
+{
+	uint8_t Command[8] = {0};
+	
+	Command[0] = Opcode;
+	AT45DB321D_AddressBytes(PageAddress, ByteAddress, &Command[1]);
+	AT45DB321D_WriteBlock(Command, 4 + DummyBytes);
+	return;
+}
+
 uint8_t AT45DB321D_ReadStatus(void)
 {
 	uint8_t StatusByte;
@@ -61,9 +357,6 @@ uint8_t AT45DB321D_ReadStatus(void)
 //
 void AT45DB321D_BufferRead(uint8_t Buffer, uint16_t BufferStartAddress, uint8_t DataReadBuffer[], uint16_t BytesToRead)
 {
-	uint16_t i;
-	//uint8_t DataByte;
-
 	//No funny stuff...
 	//TODO: add check for length and start address
 	if( (Buffer != 1) && (Buffer != 2) )
@@ -71,40 +364,26 @@ void AT45DB321D_BufferRead(uint8_t Buffer, uint16_t BufferStartAddress, uint8_t
 		return;
 	}
 	
+	//The address is 3 bytes, but only the 10 LSBs matter. An extra byte needs to be clocked in to initalize the read.
+	AT45DB321D_WaitIfBusy(Buffer);
 	AT45DB321D_Select();
 	if(Buffer == 1)
 	{
-		SPISendByte(AT45DB321D_CMD_BUFFER1_READ_HS);
+		AT45DB321D_SendCommand(AT45DB321D_CMD_BUFFER1_READ_HS, 0, BufferStartAddress, 1);
 	}
 	else
 	{
-		SPISendByte(AT45DB321D_CMD_BUFFER2_READ_HS);
-	}
-	
-	//Send address to read
-	//The address is 3 bytes, but only the 10 LSBs matter
-	SPISendByte(0x00);
-	SPISendByte((BufferStartAddress & 0x0300)>>8);
-	SPISendByte(BufferStartAddress & 0xFF);
-	
-	//An extra byte needs to be clocked in to initalize the read
-	SPISendByte(0x00);
-	
-	for(i = 0; i<BytesToRead; i++)
-	{
-		*DataReadBuffer = SPISendByte(0x00);
-		//printf_P(PSTR("[%u]: 0x%02X\n"), i, *DataReadBuffer);
-		DataReadBuffer++;
+		AT45DB321D_SendCommand(AT45DB321D_CMD_BUFFER2_READ_HS, 0, BufferStartAddress, 1);
 	}
+	AT45DB321D_ReadBlock(DataReadBuffer, BytesToRead);
 	AT45DB321D_Deselect();
+	AT45DB321D_BufferLastUsed = Buffer;
 
 	return;
 }
 
 void AT45DB321D_BufferWrite(uint8_t Buffer, uint16_t BufferStartAddress, uint8_t DataWriteBuffer[], uint16_t BytesToWrite)
 {
-	uint16_t i;
-
 	//No funny stuff...
 	//TODO: add check for length and start address
 	if( (Buffer != 1) && (Buffer != 2) )
@@ -112,30 +391,49 @@ void AT45DB321D_BufferWrite(uint8_t Buffer, uint16_t BufferStartAddress, uint8_t
 		return;
 	}
 	
+	//The address is 3 bytes, but only the 10 LSBs matter (9 LSBs for 512 mode)
+	AT45DB321D_WaitIfBusy(Buffer);
 	AT45DB321D_Select();
 	if(Buffer == 1)
 	{
-		SPISendByte(AT45DB321D_CMD_BUFFER1_WRITE);
+		AT45DB321D_SendCommand(AT45DB321D_CMD_BUFFER1_WRITE, 0, BufferStartAddress, 0);
 	}
 	else
 	{
-		SPISendByte(AT45DB321D_CMD_BUFFER2_WRITE);
+		AT45DB321D_SendCommand(AT45DB321D_CMD_BUFFER2_WRITE, 0, BufferStartAddress, 0);
 	}
+	AT45DB321D_WriteBlock(DataWriteBuffer, BytesToWrite);
+	AT45DB321D_Deselect();
+	AT45DB321D_BufferDirty[Buffer-1] = 1;
+	AT45DB321D_BufferLastUsed = Buffer;
 
-	//Send address to read
-	//The address is 3 bytes, but only the 10 LSBs matter (9 LSBs for 512 mode)
-	SPISendByte(0x00);
-	SPISendByte((BufferStartAddress & 0x0300)>>8);
-	SPISendByte(BufferStartAddress & 0xFF);
-	
-	for(i = 0; i<BytesToWrite; i++)
-	{
-		//printf_P(PSTR("write: 0x%02X\n"), *DataWriteBuffer);
-		SPISendByte(*DataWriteBuffer);
-		DataWriteBuffer++;
-	}
+	return;
+}
+
+void AT45DB321D_PageRead(uint16_t PageAddress, uint16_t StartAddress, uint8_t DataReadBuffer[], uint16_t BytesToRead)
+{
+	//Four extra bytes need to be clocked in to initalize the read
+	AT45DB321D_WaitIfBusy(0);
+	AT45DB321D_Select();
+	AT45DB321D_SendCommand(AT45DB321D_CMD_PAGE_READ, PageAddress, StartAddress, 4);
+	AT45DB321D_ReadBlock(DataReadBuffer, BytesToRead);
 	AT45DB321D_Deselect();
+	
+	return;
+}
+
+void AT45DB321D_ContinuousReadStart(uint16_t PageAddress, uint16_t ByteAddress)
+{
+	//An extra byte needs to be clocked in to initalize the read
+	AT45DB321D_WaitIfBusy(0);
+	AT45DB321D_Select();
+	AT45DB321D_SendCommand(AT45DB321D_CMD_ARRAY_READ_HF, PageAddress, ByteAddress, 1);
+	return;
+}
 
+void AT45DB321D_ContinuousRead(uint8_t DataReadBuffer[], uint16_t BytesToRead)
+{
+	AT45DB321D_ReadBlock(DataReadBuffer, BytesToRead);
 	return;
 }
 
@@ -147,7 +445,15 @@ void AT45DB321D_CopyPageToBuffer(uint8_t Buffer, uint16_t PageAddress)
 	{
 		return;
 	}
+	
+	//The buffer already holds the page
+	AT45DB321D_BufferLastUsed = Buffer;
+	if((AT45DB321D_BufferPage[Buffer-1] == PageAddress) && (AT45DB321D_BufferDirty[Buffer-1] == 0))
+	{
+		return;
+	}
 
+	AT45DB321D_WaitIfBusy(0);
 	AT45DB321D_Select();
 	if(Buffer == 1)
 	{
@@ -162,8 +468,15 @@ void AT45DB321D_CopyPageToBuffer(uint8_t Buffer, uint16_t PageAddress)
 	AT45DB321D_SendPageAddress(PageAddress);
 	
 	AT45DB321D_Deselect();
+	AT45DB321D_SetBusy(Buffer, AT45DB321D_TIMEOUT_TRANSFER_MS);
 	
-	//Add code to check for complete?
+	//A stale copy of the page in the other buffer must not be found
+	if((AT45DB321D_BufferPage[2-Buffer] == PageAddress) && (AT45DB321D_BufferDirty[2-Buffer] == 0))
+	{
+		AT45DB321D_BufferPage[2-Buffer] = AT45DB321D_NO_PAGE;
+	}
+	AT45DB321D_BufferPage[Buffer-1] = PageAddress;
+	AT45DB321D_BufferDirty[Buffer-1] = 0;
 	
 	return;
 }
@@ -177,6 +490,7 @@ void AT45DB321D_CopyBufferToPage(uint8_t Buffer, uint16_t PageAddress)
 		return;
 	}
 
+	AT45DB321D_WaitIfBusy(0);
 	AT45DB321D_Select();
 	if(Buffer == 1)
 	{
@@ -191,49 +505,262 @@ void AT45DB321D_CopyBufferToPage(uint8_t Buffer, uint16_t PageAddress)
 	AT45DB321D_SendPageAddress(PageAddress);
 	
 	AT45DB321D_Deselect();
+	AT45DB321D_SetBusy(Buffer, AT45DB321D_TIMEOUT_PROGRAM_ERASE_MS);
+	AT45DB321D_CacheProgrammed(Buffer, PageAddress);
+	
+	return;
+}
+
+void AT45DB321D_ProgramPage(uint8_t Buffer, uint16_t PageAddress, uint16_t BufferStartAddress, uint8_t DataWriteBuffer[], uint16_t BytesToWrite)
+{
+	//No funny stuff...
+	if( (Buffer != 1) && (Buffer != 2) )
+	{
+		return;
+	}
+	
+	//The data goes into the buffer, then the whole buffer is written to the page with the built in erase when the device is deselected
+	AT45DB321D_WaitIfBusy(0);
+	AT45DB321D_Select();
+	if(Buffer == 1)
+	{
+		AT45DB321D_SendCommand(AT45DB321D_CMD_PAGE_PROGRAM_BUFFER1, PageAddress, BufferStartAddress, 0);
+	}
+	else
+	{
+		AT45DB321D_SendCommand(AT45DB321D_CMD_PAGE_PROGRAM_BUFFER2, PageAddress, BufferStartAddress, 0);
+	}
+	AT45DB321D_WriteBlock(DataWriteBuffer, BytesToWrite);
+	AT45DB321D_Deselect();
+	AT45DB321D_SetBusy(Buffer, AT45DB321D_TIMEOUT_PROGRAM_ERASE_MS);
+	AT45DB321D_CacheProgrammed(Buffer, PageAddress);
 	
-	//Add code to check for complete?
+	return;
+}
+
+void AT45DB321D_CopyBufferToPageNoErase(uint8_t Buffer, uint16_t PageAddress)
+{
+	//No funny stuff...
+	if( (Buffer != 1) && (Buffer != 2) )
+	{
+		return;
+	}
+
+	AT45DB321D_WaitIfBusy(0);
+	AT45DB321D_Select();
+	if(Buffer == 1)
+	{
+		SPISendByte(AT45DB321D_CMD_BUFFER1_TO_PAGE_NOERASE);
+	}
+	else
+	{
+		SPISendByte(AT45DB321D_CMD_BUFFER2_TO_PAGE_NOERASE);
+	}
+	AT45DB321D_SendPageAddress(PageAddress);
+	AT45DB321D_Deselect();
+	AT45DB321D_SetBusy(Buffer, AT45DB321D_TIMEOUT_PROGRAM_MS);
+	AT45DB321D_CacheProgrammed(Buffer, PageAddress);
 	
 	return;
 }
 
+void AT45DB321D_CompareBuffer(uint8_t Buffer, uint16_t PageAddress)
+{
+	//No funny stuff...
+	if( (Buffer != 1) && (Buffer != 2) )
+	{
+		return;
+	}
+
+	AT45DB321D_WaitIfBusy(0);
+	AT45DB321D_Select();
+	if(Buffer == 1)
+	{
+		SPISendByte(AT45DB321D_CMD_MEMORY_TO_BUFFER1_COMPARE);
+	}
+	else
+	{
+		SPISendByte(AT45DB321D_CMD_MEMORY_TO_BUFFER2_COMPARE);
+	}
+	AT45DB321D_SendPageAddress(PageAddress);
+	AT45DB321D_Deselect();
+	AT45DB321D_SetBusy(Buffer, AT45DB321D_TIMEOUT_TRANSFER_MS);
+	return;
+}
+
+uint8_t AT45DB321D_VerifyPage(uint8_t Buffer, uint16_t PageAddress)
+{
+	uint8_t StatusByte;
+	
+	if( (Buffer != 1) && (Buffer != 2) )
+	{
+		return 0;
+	}
+	
+	//The compare waits for a write to the page to finish before it starts
+	AT45DB321D_CompareBuffer(Buffer, PageAddress);
+	StatusByte = AT45DB321D_WaitForReady();
+	if((StatusByte & AT45DB321D_STATUS_READY_MASK) != AT45DB321D_STATUS_READY_MASK)
+	{
+		return 0;
+	}
+	if((StatusByte & AT45DB321D_STATUS_COMPARE_MASK) != 0)
+	{
+		//The page does not match, so the buffer is not a copy of it
+		AT45DB321D_BufferDirty[Buffer-1] = 1;
+		return 0;
+	}
+	return 1;
+}
+
 void AT45DB321D_ErasePage(uint16_t PageAddress)
 {
+	AT45DB321D_WaitIfBusy(0);
 	AT45DB321D_Select();
 	SPISendByte(AT45DB321D_CMD_PAGE_ERASE);
 	AT45DB321D_SendPageAddress(PageAddress);
 	AT45DB321D_Deselect();
+	AT45DB321D_SetBusy(0, AT45DB321D_TIMEOUT_PAGE_ERASE_MS);
+	AT45DB321D_CacheErased(PageAddress, 1);
+	return;
+}
+
+void AT45DB321D_BlockErase(uint16_t BlockAddress)
+{
+	//The block address takes the place of the upper bits of the page address
+	AT45DB321D_WaitIfBusy(0);
+	AT45DB321D_Select();
+	SPISendByte(AT45DB321D_CMD_BLOCK_ERASE);
+	AT45DB321D_SendPageAddress(BlockAddress * AT45DB321D_PAGES_PER_BLOCK);
+	AT45DB321D_Deselect();
+	AT45DB321D_SetBusy(0, AT45DB321D_TIMEOUT_BLOCK_ERASE_MS);
+	AT45DB321D_CacheErased(BlockAddress * AT45DB321D_PAGES_PER_BLOCK, AT45DB321D_PAGES_PER_BLOCK);
+	return;
+}
+
+void AT45DB321D_SectorErase(uint8_t SectorAddress)
+{
+	AT45DB321D_WaitIfBusy(0);
+	AT45DB321D_Select();
+	SPISendByte(AT45DB321D_CMD_SECTOR_ERASE);
+	if(SectorAddress == 0)
+	{
+		//Sector 0b starts at the second block
+		AT45DB321D_SendPageAddress(AT45DB321D_PAGES_PER_BLOCK);
+		AT45DB321D_CacheErased(AT45DB321D_PAGES_PER_BLOCK, AT45DB321D_PagesPerSector - AT45DB321D_PAGES_PER_BLOCK);
+	}
+	else
+	{
+		AT45DB321D_SendPageAddress((uint16_t)SectorAddress * AT45DB321D_PagesPerSector);
+		AT45DB321D_CacheErased((uint16_t)SectorAddress * AT45DB321D_PagesPerSector, AT45DB321D_PagesPerSector);
+	}
+	AT45DB321D_Deselect();
+	AT45DB321D_SetBusy(0, AT45DB321D_TIMEOUT_SECTOR_ERASE_MS);
 	return;
 }
 
+uint8_t AT45DB321D_IsReady(void)
+{
+	if(AT45DB321D_Busy == 0)
+	{
+		return 1;
+	}
+	if((AT45DB321D_ReadStatus() & AT45DB321D_STATUS_READY_MASK) != AT45DB321D_STATUS_READY_MASK)
+	{
+		return 0;
+	}
+	AT45DB321D_Busy = 0;
+	AT45DB321D_BusyBuffer = 0;
+	return 1;
+}
+
 uint8_t AT45DB321D_WaitForReady(void)
- {
-	uint8_t StatusByte = 0x00;
-	while((StatusByte & AT45DB321D_STATUS_READY_MASK) != AT45DB321D_STATUS_READY_MASK)
+{
+	if(AT45DB321D_Busy == 0)
 	{
-		StatusByte = AT45DB321D_ReadStatus();
+		//Nothing was started by the driver, but commands sent some other way may still be running
+		return AT45DB321D_WaitForReadyUntil(GetTickMS() + AT45DB321D_TIMEOUT_DEFAULT_MS + 1);
 	}
+	return AT45DB321D_WaitForReadyUntil(AT45DB321D_BusyDeadline);
+}
+
+uint8_t AT45DB321D_WaitForReadyUntil(uint32_t Deadline)
+{
+	uint8_t StatusByte;
+	
+	//The status register is sent over and over for as long as the device is selected
+	AT45DB321D_Select();
+	SPISendByte(AT45DB321D_CMD_READ_STATUS);
+	do
+	{
+		StatusByte = SPISendByte(0x00);
+	} while(((StatusByte & AT45DB321D_STATUS_READY_MASK) != AT45DB321D_STATUS_READY_MASK) && ((int32_t)(GetTickMS() - Deadline) < 0));
+	AT45DB321D_Deselect();
+	
+	//Give up on the operation if it ran past its deadline, so a failed part does not hang every command after it
+	AT45DB321D_Busy = 0;
+	AT45DB321D_BusyBuffer = 0;
 	return StatusByte;
- }
+}
+
+//Record that an operation using buffer 'Buffer' (0 for main memory only) was just started and takes at most 'TimeoutMS'
+static void AT45DB321D_SetBusy(uint8_t Buffer, uint32_t TimeoutMS)
+{
+	AT45DB321D_Busy = 1;
+	AT45DB321D_BusyBuffer = Buffer;
+	
+	//The tick may be about to change, so allow one more
+	AT45DB321D_BusyDeadline = GetTickMS() + TimeoutMS + 1;
+	return;
+}
+
+//Wait for the operation in progress if the next command needs what it is using.
+//Buffer reads and writes only touch their own buffer, so they can go on while the other buffer or main memory is busy. Pass 0 for anything that uses main memory.
+static void AT45DB321D_WaitIfBusy(uint8_t Buffer)
+{
+	if(AT45DB321D_Busy == 0)
+	{
+		return;
+	}
+	if((Buffer != 0) && (Buffer != AT45DB321D_BusyBuffer))
+	{
+		return;
+	}
+	AT45DB321D_WaitForReady();
+	return;
+}
 
 void AT45DB321D_SendPageAddress(uint16_t PageAddress)
 {
-	//Send page address, this is different for 512 and 528 mode
-	#if AT45DB321D_PAGE_SIZE_BYTES == 512
-	SPISendByte( (uint8_t)(PageAddress>>7) );
-	SPISendByte( (uint8_t)(PageAddress<<1) );
-	SPISendByte(0x00);
-	#else
-	SPISendByte( (uint8_t)(PageAddress>>6) );
-	SPISendByte( (uint8_t)(PageAddress<<2) );
-	SPISendByte(0x00);
-	#endif
+	AT45DB321D_SendAddress(PageAddress, 0);
+	return;
+}
+
+void AT45DB321D_SendAddress(uint16_t PageAddress, uint16_t ByteAddress)
+{
+	uint8_t Address[3];
+	
+	AT45DB321D_AddressBytes(PageAddress, ByteAddress, Address);
+	AT45DB321D_WriteBlock(Address, 3);
+	return;
+}
+
+void AT45DB321D_AddressBytes(uint16_t PageAddress, uint16_t ByteAddress, uint8_t Address[])
+{
+	uint32_t FullAddress;
+	
+	//The page address is shifted above the byte address. The number of byte address bits depends on the part and the page size.
+	FullAddress = ((uint32_t)PageAddress << AT45DB321D_AddressShift) | (ByteAddress & ((1U << AT45DB321D_AddressShift) - 1));
+	Address[0] = (uint8_t)(FullAddress >> 16);
+	Address[1] = (uint8_t)(FullAddress >> 8);
+	Address[2] = (uint8_t)(FullAddress & 0xFF);
 	return;
 }
 
 //Untested
 void AT45DB321D_Powerdown(void)
 {
+	AT45DB321D_WaitIfBusy(0);
 	AT45DB321D_Select();
 	SPISendByte(AT45DB321D_CMD_POWERDOWN);
 	AT45DB321D_Deselect();
@@ -250,17 +777,21 @@ void AT45DB321D_Powerup(void)
 
 void AT45DB321D_ChipErase(void)
 {
+	AT45DB321D_WaitIfBusy(0);
 	AT45DB321D_Select();
 	SPISendByte(AT45DB321D_CMD_CHIP_ERASE1);
 	SPISendByte(AT45DB321D_CMD_CHIP_ERASE2);
 	SPISendByte(AT45DB321D_CMD_CHIP_ERASE3);
 	SPISendByte(AT45DB321D_CMD_CHIP_ERASE4);
 	AT45DB321D_Deselect();
+	AT45DB321D_SetBusy(0, AT45DB321D_TIMEOUT_CHIP_ERASE_MS);
+	AT45DB321D_CacheErased(0, 0xFFFF);
 	return;
 }
 
 void AT45DB321D_Protect(void)
 {
+	AT45DB321D_WaitIfBusy(0);
 	AT45DB321D_Select();
 	SPISendByte(0x3D);
 	SPISendByte(0x2A);
@@ -272,6 +803,7 @@ void AT45DB321D_Protect(void)
 
 void AT45DB321D_Unprotect(void)
 {
+	AT45DB321D_WaitIfBusy(0);
 	AT45DB321D_Select();
 	SPISendByte(0x3D);
 	SPISendByte(0x2A);
@@ -300,4 +832,4 @@ void AT45DB321D_SwitchTo512(void)
 }
 #endif
 
-/** @} */
\ No newline at end of file
+/** @} */
\ No newline at end of file
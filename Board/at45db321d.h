@@ -28,11 +28,28 @@
 
 #include "stdint.h"
 
+//The geometry of the part is read from the device at startup, see AT45DB321D_ReadGeometry. These are the AT45DB321D values, used if the part is not known.
 #define AT45DB321D_PAGE_SIZE_BYTES		528
-#if (AT45DB321D_PAGE_SIZE_BYTES != 512) && (AT45DB321D_PAGE_SIZE_BYTES != 528)
+#define AT45DB321D_PAGES_PER_BLOCK		8		//The same for all of the supported parts
+#define AT45DB321D_PAGES_PER_SECTOR		128
+#define AT45DB321D_DEFAULT_PAGE_COUNT	8192
+#if AT45DB321D_PAGE_SIZE_BYTES == 512
+	#define AT45DB321D_DEFAULT_ADDRESS_SHIFT	9
+#elif AT45DB321D_PAGE_SIZE_BYTES == 528
+	#define AT45DB321D_DEFAULT_ADDRESS_SHIFT	10
+#else
 	#error: Page size is incorrect. Must be 512 or 528.
 #endif
 
+//Device ID
+#define AT45DB321D_MANUFACTURER_ATMEL	0x1F
+#define AT45DB321D_FAMILY_DATAFLASH		0x20	//Top 3 bits of the second ID byte
+#define AT45DB321D_DENSITY_4MBIT		0x04	//AT45DB041, 2048 pages of 264 bytes
+#define AT45DB321D_DENSITY_8MBIT		0x05	//AT45DB081, 4096 pages of 264 bytes
+#define AT45DB321D_DENSITY_16MBIT		0x06	//AT45DB161, 4096 pages of 528 bytes
+#define AT45DB321D_DENSITY_32MBIT		0x07	//AT45DB321, 8192 pages of 528 bytes
+#define AT45DB321D_DENSITY_64MBIT		0x08	//AT45DB642, 8192 pages of 1056 bytes
+
 #define AT45DB321D_CMD_ARRAY_READ_LEGACY			0xE8
 #define AT45DB321D_CMD_ARRAY_READ_HF				0x0B
 #define AT45DB321D_CMD_ARRAY_READ_LF				0x03
@@ -76,10 +93,43 @@
 #define AT45DB321D_CMD_CHIP_ERASE3					0x80
 #define AT45DB321D_CMD_CHIP_ERASE4					0x9A
 
+#define AT45DB321D_NO_PAGE							0xFFFF	//Page number used when a buffer does not hold a known page
+
 //Status register masks
 #define AT45DB321D_STATUS_READY_MASK				0x80
-
+#define AT45DB321D_STATUS_COMPARE_MASK				0x40	//Set if the last compare found a difference
+#define AT45DB321D_STATUS_PAGE_SIZE_MASK			0x01	//Set if the part uses power of 2 page sizes
+
+//Longest time each operation can take, from the datasheet. The driver waits this long for the device before it gives up.
+#define AT45DB321D_TIMEOUT_TRANSFER_MS				1		//Page to buffer transfer, 200us
+#define AT45DB321D_TIMEOUT_PROGRAM_MS				6		//Buffer to page without erase
+#define AT45DB321D_TIMEOUT_PROGRAM_ERASE_MS			40		//Buffer to page with erase
+#define AT45DB321D_TIMEOUT_PAGE_ERASE_MS			35
+#define AT45DB321D_TIMEOUT_BLOCK_ERASE_MS			100
+#define AT45DB321D_TIMEOUT_SECTOR_ERASE_MS			5000
+#define AT45DB321D_TIMEOUT_CHIP_ERASE_MS			80000UL
+#define AT45DB321D_TIMEOUT_DEFAULT_MS				100		//Used when the driver did not start the operation
+
+/** Initalize the driver and read the geometry of the part */
 void AT45DB321D_Init(void);
+
+/** Read the JEDEC ID and the page size bit of the status register to find the number of pages, the page size and the address layout of the part.
+ *	AT45DB041, 081, 161, 321 and 642 parts are supported. Returns 1 if the part is known, 0 if the AT45DB321D geometry is kept.
+ */
+uint8_t AT45DB321D_ReadGeometry(void);
+
+/** Returns the number of pages in main memory */
+uint16_t AT45DB321D_GetPageCount(void);
+
+/** Returns the size of a page (and of each buffer) in bytes */
+uint16_t AT45DB321D_GetPageSize(void);
+
+/** Returns the number of pages in a sector, except for sector 0 which is split in two */
+uint16_t AT45DB321D_GetPagesPerSector(void);
+
+/** Returns the number of bits the page address is shifted by in the three address bytes, this is the number of byte address bits */
+uint8_t AT45DB321D_GetAddressShift(void);
+
 void AT45DB321D_Select(void);
 void AT45DB321D_Deselect(void);
 
@@ -92,24 +142,112 @@ void AT45DB321D_BufferRead(uint8_t Buffer, uint16_t BufferStartAddress, uint8_t
 /** Writes 'BytesToWrite' bytes from 'DataWriteBuffer' to buffer number 'Buffer' starting at address 'BufferStartAddress' */
 void AT45DB321D_BufferWrite(uint8_t Buffer, uint16_t BufferStartAddress, uint8_t DataWriteBuffer[], uint16_t BytesToWrite);
 
-/** Copies the contents of main memory page 'PageAddress' into buffer number 'Buffer' */
+/** Reads 'BytesToRead' bytes directly from main memory page 'PageAddress' starting at 'StartAddress'. Neither buffer is modified. */
+void AT45DB321D_PageRead(uint16_t PageAddress, uint16_t StartAddress, uint8_t DataReadBuffer[], uint16_t BytesToRead);
+
+/** Starts a continuous read of main memory at byte 'ByteAddress' of page 'PageAddress'.
+ *	The device is left selected. Read the data with AT45DB321D_ContinuousRead and end the read with AT45DB321D_Deselect.
+ *	The read wraps from the end of one page to the start of the next.
+ */
+void AT45DB321D_ContinuousReadStart(uint16_t PageAddress, uint16_t ByteAddress);
+
+/** Reads the next 'BytesToRead' bytes of a continuous read started with AT45DB321D_ContinuousReadStart */
+void AT45DB321D_ContinuousRead(uint8_t DataReadBuffer[], uint16_t BytesToRead);
+
+/** Copies the contents of main memory page 'PageAddress' into buffer number 'Buffer'. Nothing is sent if the buffer already holds an unchanged copy of the page. */
 void AT45DB321D_CopyPageToBuffer(uint8_t Buffer, uint16_t PageAddress);
 
 /** Copies the contents of 'Buffer' into main memory page 'PageAddress.' Uses the write-with-erase command. */
 void AT45DB321D_CopyBufferToPage(uint8_t Buffer, uint16_t PageAddress);
 
+/** Writes 'BytesToWrite' bytes from 'DataWriteBuffer' to buffer number 'Buffer' starting at address 'BufferStartAddress', then copies the buffer into main memory page 'PageAddress'.
+ *	This is AT45DB321D_BufferWrite followed by AT45DB321D_CopyBufferToPage in a single command. The rest of the buffer is written to the page as it is.
+ */
+void AT45DB321D_ProgramPage(uint8_t Buffer, uint16_t PageAddress, uint16_t BufferStartAddress, uint8_t DataWriteBuffer[], uint16_t BytesToWrite);
+
+/** Copies the contents of 'Buffer' into main memory page 'PageAddress.' Uses the write-without-erase command, so the page must already be erased. */
+void AT45DB321D_CopyBufferToPageNoErase(uint8_t Buffer, uint16_t PageAddress);
+
+/** Start a compare of main memory page 'PageAddress' with buffer number 'Buffer'. The result is in the status register when the device is ready. */
+void AT45DB321D_CompareBuffer(uint8_t Buffer, uint16_t PageAddress);
+
+/** Compare main memory page 'PageAddress' with buffer number 'Buffer' on the device and wait for the result.
+ *	This is used to check a page after the buffer is written to it, without reading the page back over SPI.
+ *	Returns 1 if the page matches the buffer, 0 if it does not or if the device did not finish.
+ */
+uint8_t AT45DB321D_VerifyPage(uint8_t Buffer, uint16_t PageAddress);
+
 /** Erase page 'PageAddress' */
 void AT45DB321D_ErasePage(uint16_t PageAddress);
 
+/** Erase block 'BlockAddress.' A block is AT45DB321D_PAGES_PER_BLOCK pages, block n starts at page n*AT45DB321D_PAGES_PER_BLOCK. */
+void AT45DB321D_BlockErase(uint16_t BlockAddress);
+
+/** Erase sector 'SectorAddress.' A sector is AT45DB321D_GetPagesPerSector() pages.
+ *	Sector 0 is split in two, sector 0 here is sector 0b (pages 8-127). Erase sector 0a with AT45DB321D_BlockErase(0).
+ */
+void AT45DB321D_SectorErase(uint8_t SectorAddress);
+
+/** Returns the buffer that holds a copy of main memory page 'PageAddress', or 0 if neither buffer does. The page is not loaded.
+ *	The buffer may have changes that are not in main memory yet, in which case it is newer than main memory.
+ */
+uint8_t AT45DB321D_CacheFindPage(uint16_t PageAddress);
+
+/** Returns a buffer that holds main memory page 'PageAddress', loading the page if needed.
+ *	The driver keeps track of the page in each buffer. If neither buffer has the page, it is copied into the least recently used buffer.
+ *	Buffers with changes that are not in main memory yet are not replaced. Returns 0 if both buffers have changes, read the page from main memory in that case.
+ */
+uint8_t AT45DB321D_CacheLoadPage(uint16_t PageAddress);
+
+/** Mark 'Buffer' as holding new data for page 'PageAddress' that is not in main memory yet. It will not be replaced by AT45DB321D_CacheLoadPage
+ *	until it is written to main memory. Call this before building a page in a buffer from scratch.
+ */
+void AT45DB321D_CacheSetPage(uint8_t Buffer, uint16_t PageAddress);
+
+/** Forget the pages held by both buffers. Call this if the buffers or main memory are changed without going through the driver. */
+void AT45DB321D_CacheInvalidate(void);
+
+/** Returns 1 if the device can take another command, 0 if an operation started by the driver is still running.
+ *	The status register is only read if an operation was started, so this is cheap to call from the main loop.
+ */
+uint8_t AT45DB321D_IsReady(void);
+
 /** Waits for the RDY/BUSY bit in the status register to go high. This indicates that the part is ready for another command.
+ *	The wait ends at the deadline of the operation in progress, or after AT45DB321D_TIMEOUT_DEFAULT_MS if the driver did not start one.
+ *	The commands that use main memory or a busy buffer call this themselves, so it does not need to be called after starting an operation.
  * 
- * Returns the status register
+ * Returns the status register. The RDY/BUSY bit is clear if the device was still busy at the deadline.
  */
 uint8_t AT45DB321D_WaitForReady(void);
 
+/** Waits for the RDY/BUSY bit in the status register to go high, or for the tick count from GetTickMS to reach 'Deadline'.
+ *	The device is kept selected and the status register is read continuously.
+ *	Returns the status register.
+ */
+uint8_t AT45DB321D_WaitForReadyUntil(uint32_t Deadline);
+
 /** Send the page address to the device */
 void AT45DB321D_SendPageAddress(uint16_t PageAddress);
 
+/** Send a page address and a byte address within that page to the device */
+void AT45DB321D_SendAddress(uint16_t PageAddress, uint16_t ByteAddress);
+
+/** Put the three address bytes for a page address and a byte address within that page into 'Address' */
+void AT45DB321D_AddressBytes(uint16_t PageAddress, uint16_t ByteAddress, uint8_t Address[]);
+
+/** Send an opcode, address and 'DummyBytes' don't care bytes (up to 4) in a single block transfer. The device must already be selected. */
+void AT45DB321D_SendCommand(uint8_t Opcode, uint16_t PageAddress, uint16_t ByteAddress, uint8_t DummyBytes);
+
+/** Read a block of bytes from the SPI bus.
+ *	The transfers are pipelined, the next byte is started as soon as the last one is stored, so the bus is only idle for a few cycles between bytes.
+ */
+void AT45DB321D_ReadBlock(uint8_t Data[], uint16_t Bytes);
+
+/** Write a block of bytes to the SPI bus.
+ *	The transfers are pipelined, the next byte is loaded while the last one is sent, so the bus does not sit idle between bytes.
+ */
+void AT45DB321D_WriteBlock(uint8_t Data[], uint16_t Bytes);
+
 /** Powerdown the device. Once powered down, the device will ignore all commands except the power up command */
 void AT45DB321D_Powerdown(void);
 
@@ -130,9 +268,6 @@ void AT45DB321D_SwitchTo512(void);
 
 
 //not implemented yet
-void AT45DB321D_BlockErase(uint16_t BlockAddress);
-void AT45DB321D_SectorErase(uint8_t SectorAddress);
-
 void AT45DB321D_ReadProtectedSectors(uint8_t *ProtectData);
 void AT45DB321D_ProtectSectors(uint8_t *ProtectData);
 
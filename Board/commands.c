@@ -28,7 +28,7 @@
 
 
 //The number of commands
-const uint8_t NumCommands = 11;
+const uint8_t NumCommands = 17;
 
 //Handler function declerations
 
@@ -54,7 +54,7 @@ const char _F3_HELPTEXT[] PROGMEM 		= "regread <register #>";
 static int _F4_Handler (void);
 const char _F4_NAME[] PROGMEM 			= "settime";
 const char _F4_DESCRIPTION[] PROGMEM 	= "Set the time";
-const char _F4_HELPTEXT[] PROGMEM 		= "settime <year> <month> <day> <dow> <hr> <min> <sec>";
+const char _F4_HELPTEXT[] PROGMEM 		= "settime <year> <month> <day> <hr> <min> <sec>, year 2000-2135 or 00-99";
 
 //Read the time from the internal timer
 static int _F5_Handler (void);
@@ -98,13 +98,53 @@ const char _F12_NAME[] PROGMEM 			= "twiscan";
 const char _F12_DESCRIPTION[] PROGMEM 	= "Scan for TWI devices";
 const char _F12_HELPTEXT[] PROGMEM 		= "'twiscan' has no parameters";
 
+//Dump the logged data in binary
+static int _F13_Handler (void);
+const char _F13_NAME[] PROGMEM 			= "dump";
+const char _F13_DESCRIPTION[] PROGMEM 	= "Binary dump of the logged data";
+const char _F13_HELPTEXT[] PROGMEM 		= "'dump' has no parameters";
+
+//Read logged data sets by number
+static int _F14_Handler (void);
+const char _F14_NAME[] PROGMEM 			= "get";
+const char _F14_DESCRIPTION[] PROGMEM 	= "Read logged data sets";
+const char _F14_HELPTEXT[] PROGMEM 		= "get <first data set> <number of data sets>, 'get 0 0' prints the number of data sets";
+
+//Search the logged data
+static int _F15_Handler (void);
+const char _F15_NAME[] PROGMEM 			= "query";
+const char _F15_DESCRIPTION[] PROGMEM 	= "Search the logged data";
+const char _F15_HELPTEXT[] PROGMEM 		= "query <field> <low> <high> <start MMDDhhmm> <end MMDDhhmm> (this year, a start after the end is last year), field 0: time only, 1: temp, 2: RH, 3: pressure, 4: clear";
+
+//Print the hourly or daily rollups
+static int _F16_Handler (void);
+const char _F16_NAME[] PROGMEM 			= "rollup";
+const char _F16_DESCRIPTION[] PROGMEM 	= "Print hourly or daily rollups";
+const char _F16_HELPTEXT[] PROGMEM 		= "rollup <1: hourly, 2: daily> <number of rollups>";
+
+//Print the profiling probes
+static int _F17_Handler (void);
+const char _F17_NAME[] PROGMEM 			= "prof";
+const char _F17_DESCRIPTION[] PROGMEM 	= "Print the profiling probes";
+const char _F17_HELPTEXT[] PROGMEM 		= "prof <1 to clear the probes after printing>";
+
+//Sampling period
+static int _F18_Handler (void);
+const char _F18_NAME[] PROGMEM 			= "period";
+const char _F18_DESCRIPTION[] PROGMEM 	= "Set the sampling period";
+const char _F18_HELPTEXT[] PROGMEM 		= "period <0: show, 1: set, 2: clear misses> <ms, 0 stops sampling>";
+
+//The sample started by the 'data' command, see Commands_PollDataSet
+static uint8_t CommandDataSetPending;
+static uint8_t CommandDataSet[DATALOGGER_DATASET_SIZE];
+
 //Command list
 const CommandListItem AppCommandList[] PROGMEM =
 {
 	{ _F1_NAME,		1,  1,	_F1_Handler,	_F1_DESCRIPTION,	_F1_HELPTEXT	},		//led
 	{ _F2_NAME, 	0,  0,	_F2_Handler,	_F2_DESCRIPTION,	_F2_HELPTEXT	},		//dfu
 	{ _F3_NAME, 	1,  1,	_F3_Handler,	_F3_DESCRIPTION,	_F3_HELPTEXT	},		//regread
-	{ _F4_NAME, 	7,  7,	_F4_Handler,	_F4_DESCRIPTION,	_F4_HELPTEXT	},		//settime
+	{ _F4_NAME, 	6,  6,	_F4_Handler,	_F4_DESCRIPTION,	_F4_HELPTEXT	},		//settime
 	{ _F5_NAME, 	0,  0,	_F5_Handler,	_F5_DESCRIPTION,	_F5_HELPTEXT	},		//gettime
 	{ _F6_NAME, 	2,  2,	_F6_Handler,	_F6_DESCRIPTION,	_F6_HELPTEXT	},		//writereg	
 	{ _F8_NAME,		0,  0,	_F8_Handler,	_F8_DESCRIPTION,	_F8_HELPTEXT	},		//data
@@ -112,6 +152,12 @@ const CommandListItem AppCommandList[] PROGMEM =
 	{ _F10_NAME,	0,  0,	_F10_Handler,	_F10_DESCRIPTION,	_F10_HELPTEXT	},		//pres
 	{ _F11_NAME,	1,  2,	_F11_Handler,	_F11_DESCRIPTION,	_F11_HELPTEXT	},		//rh
 	{ _F12_NAME,	0,  0,	_F12_Handler,	_F12_DESCRIPTION,	_F12_HELPTEXT	},		//twiscan
+	{ _F13_NAME,	0,  0,	_F13_Handler,	_F13_DESCRIPTION,	_F13_HELPTEXT	},		//dump
+	{ _F14_NAME,	2,  2,	_F14_Handler,	_F14_DESCRIPTION,	_F14_HELPTEXT	},		//get
+	{ _F15_NAME,	5,  5,	_F15_Handler,	_F15_DESCRIPTION,	_F15_HELPTEXT	},		//query
+	{ _F16_NAME,	2,  2,	_F16_Handler,	_F16_DESCRIPTION,	_F16_HELPTEXT	},		//rollup
+	{ _F17_NAME,	0,  1,	_F17_Handler,	_F17_DESCRIPTION,	_F17_HELPTEXT	},		//prof
+	{ _F18_NAME,	1,  2,	_F18_Handler,	_F18_DESCRIPTION,	_F18_HELPTEXT	},		//period
 };
 
 //Command functions
@@ -126,9 +172,17 @@ static int _F1_Handler (void)
 //Jump to DFU bootloader
 static int _F2_Handler (void)
 {
+	int16_t Key;
+	
 	printf_P(PSTR("Jumping to bootloader. A manual reset will be required\nPress 'y' to continue..."));
 	
-	if(WaitForAnyKey() == 'y')
+	//Commands run from the main loop, which is also where received characters go to the command parser, so read the key directly
+	do
+	{
+		Key = USBSerial_ReceiveByte();
+	} while(Key < 0);
+	
+	if(Key == 'y')
 	{
 		printf_P(PSTR("Jump\n"));
 		DelayMS(100);
@@ -164,14 +218,24 @@ static int _F3_Handler (void)
 static int _F4_Handler (void)
 {
 	TimeAndDate CurrentTime;
-	//<year> <month> <day> <dow> <hr> <min> <sec>
+	//<year> <month> <day> <hr> <min> <sec>, the day of the week comes from the date
 	CurrentTime.year	= argAsInt(1);
 	CurrentTime.month	= argAsInt(2);
 	CurrentTime.day		= argAsInt(3);
-	CurrentTime.dow		= argAsInt(4);
-	CurrentTime.hour	= argAsInt(5);
-	CurrentTime.min		= argAsInt(6);
-	CurrentTime.sec		= argAsInt(7);
+	CurrentTime.hour	= argAsInt(4);
+	CurrentTime.min		= argAsInt(5);
+	CurrentTime.sec		= argAsInt(6);
+	
+	//SetTime ignores a year it can not count to, so say so instead of setting the rest of the date in the wrong year
+	if(CurrentTime.year < 100)
+	{
+		CurrentTime.year += HARDWARE_EPOCH_YEAR;
+	}
+	if((CurrentTime.year < HARDWARE_EPOCH_YEAR) || (CurrentTime.year > HARDWARE_EPOCH_LAST_YEAR))
+	{
+		printf_P(PSTR("Error: year must be %u-%u\n"), HARDWARE_EPOCH_YEAR, HARDWARE_EPOCH_LAST_YEAR);
+		return 0;
+	}
 	SetTime(CurrentTime);
 	printf_P(PSTR("Setting %02u/%02u/%04u %02u:%02u:%02u"), CurrentTime.month, CurrentTime.day, CurrentTime.year, CurrentTime.hour, CurrentTime.min, CurrentTime.sec);
 	
@@ -213,17 +277,16 @@ static int _F6_Handler (void)
 //Get a set of data from the devices
 static int _F8_Handler (void)
 {
-	uint8_t DataSet[18];
-	uint8_t i;
-	
-	
-	GetDataSet(DataSet);
-	
+	uint8_t stat;
 	
-	for(i=0;i<19;i++)
+	//The data set is printed by Commands_PollDataSet when the sample is done, so the other tasks run while the sensors convert
+	stat = StartDataSet();
+	if(stat != DATASET_STATUS_BUSY)
 	{
-		printf_P(PSTR("%u: 0x%02X\n"), i, DataSet[i]);
+		printf_P(PSTR("Error: %u\n"), stat);
+		return 0;
 	}
+	CommandDataSetPending = 1;
 	
 	
 	/*uint16_t LS_Data[4];
@@ -290,6 +353,36 @@ static int _F8_Handler (void)
 	return 0;
 }
 
+void Commands_PollDataSet(void)
+{
+	uint8_t stat;
+	uint8_t i;
+	
+	if(CommandDataSetPending == 0)
+	{
+		return;
+	}
+	
+	stat = PollDataSet(CommandDataSet);
+	if(stat == DATASET_STATUS_BUSY)
+	{
+		return;
+	}
+	CommandDataSetPending = 0;
+	
+	if(stat != DATASET_STATUS_OK)
+	{
+		printf_P(PSTR("Error: %u\n"), stat);
+		return;
+	}
+	
+	for(i=0;i<DATALOGGER_DATASET_SIZE;i++)
+	{
+		printf_P(PSTR("%u: 0x%02X\n"), i, CommandDataSet[i]);
+	}
+	return;
+}
+
 //Read a register from the memory
 static int _F9_Handler (void)
 {
@@ -309,13 +402,13 @@ static int _F9_Handler (void)
 	else if(RegToRead == 2)	//Read status
 	{
 		//SPI_Init(SPI_SPEED_FCPU_DIV_2 | SPI_ORDER_MSB_FIRST | SPI_SCK_LEAD_FALLING | SPI_SAMPLE_TRAILING | SPI_MODE_MASTER);		
-		InitSPIMaster(0,0);		//Mode 0,0 is good
+		SPIInit();		//Mode 0,0 is good
 		printf_P(PSTR("Stat: 0x%02X\n"), AT45DB321D_ReadStatus());
 	}
 	else if(RegToRead == 3)	//Read IDs
 	{
 		//SPI_Init(SPI_SPEED_FCPU_DIV_2 | SPI_ORDER_MSB_FIRST | SPI_SCK_LEAD_FALLING | SPI_SAMPLE_TRAILING | SPI_MODE_MASTER);		
-		InitSPIMaster(0,0);		//Mode 0,0 is good
+		SPIInit();		//Mode 0,0 is good
 		AT45DB321D_Select();
 		SPISendByte(AT45DB321D_CMD_READ_DEVICE_ID);
 		printf_P(PSTR("ID[1]: 0x%02X\n"), SPISendByte(0x00));
@@ -496,4 +589,178 @@ static int _F12_Handler (void)
 	return  0;
 }
 
+//Dump the logged data in binary
+static int _F13_Handler (void)
+{
+	Datalogger_DumpData();
+	return 0;
+}
+
+//Read logged data sets by number
+static int _F14_Handler (void)
+{
+	uint32_t DataSetNumber	= argAsInt(1);
+	uint16_t DataSetsToRead	= argAsInt(2);
+	uint8_t DataSet[DATALOGGER_DATASET_SIZE];
+	uint8_t i;
+	
+	if(DataSetsToRead == 0)
+	{
+		printf_P(PSTR("%lu data sets\n"), Datalogger_GetDataSetCount());
+		return 0;
+	}
+	
+	while(DataSetsToRead > 0)
+	{
+		if(Datalogger_RetrieveDataFromFlash(DataSetNumber, DataSet) != 1)
+		{
+			printf_P(PSTR("No data set %lu\n"), DataSetNumber);
+			return 0;
+		}
+		
+		printf_P(PSTR("%lu: "), DataSetNumber);
+		for(i=0; i<DATALOGGER_DATASET_SIZE; i++)
+		{
+			printf_P(PSTR("0x%02X, "), DataSet[i]);
+		}
+		printf_P(PSTR("\b\b \b\n"));
+		
+		DataSetNumber++;
+		DataSetsToRead--;
+	}
+	return 0;
+}
+
+//Put the month, day, hour and minute from MMDDhhmm into Time. Returns 0 without changing Time if any of them is out of range.
+//The day is checked against the length of the month in the year already in Time.
+static uint8_t QueryTimeFromArg(uint32_t MMDDhhmm, TimeAndDate *Time)
+{
+	uint32_t Month	= MMDDhhmm/1000000;
+	uint8_t Day		= (MMDDhhmm/10000)%100;
+	uint8_t Hour	= (MMDDhhmm/100)%100;
+	uint8_t Min		= MMDDhhmm%100;
+	uint8_t NumberOfDaysPerMonth;
+	
+	if((Month < 1) || (Month > 12) || (Hour > 23) || (Min > 59))
+	{
+		return 0;
+	}
+	
+	NumberOfDaysPerMonth = DaysPerMonth(Month);
+	if((Month == 2) && (IsLeapYear(Time->year) == 1))
+	{
+		NumberOfDaysPerMonth = 29;
+	}
+	if((Day < 1) || (Day > NumberOfDaysPerMonth))
+	{
+		return 0;
+	}
+	
+	Time->month	= Month;
+	Time->day	= Day;
+	Time->hour	= Hour;
+	Time->min	= Min;
+	return 1;
+}
+
+//Search the logged data
+static int _F15_Handler (void)
+{
+	uint8_t Field	= argAsInt(1);
+	int32_t Low		= argAsInt(2);
+	int32_t High	= argAsInt(3);
+	uint32_t StartTime;
+	uint32_t EndTime;
+	uint16_t Matches;
+	TimeAndDate QueryTime;
+	
+	//Convert MMDDhhmm in the current year to a time stamp. The end time covers the whole minute.
+	GetTime(&QueryTime);
+	QueryTime.sec	= 0;
+	if(QueryTimeFromArg(argAsInt(4), &QueryTime) == 0)
+	{
+		printf_P(PSTR("Error: bad start time\n"));
+		return 0;
+	}
+	StartTime		= TimeToEpoch(&QueryTime);
+	if(QueryTimeFromArg(argAsInt(5), &QueryTime) == 0)
+	{
+		printf_P(PSTR("Error: bad end time\n"));
+		return 0;
+	}
+	EndTime			= TimeToEpoch(&QueryTime) + 59;
+	
+	//A start after the end is in the year before, so a query can run from December into January
+	if(StartTime > EndTime)
+	{
+		QueryTime.year--;
+		if((QueryTime.year < HARDWARE_EPOCH_YEAR) || (QueryTimeFromArg(argAsInt(4), &QueryTime) == 0))
+		{
+			printf_P(PSTR("Error: bad start time\n"));
+			return 0;
+		}
+		StartTime	= TimeToEpoch(&QueryTime);
+	}
+	
+	Matches = Datalogger_Query(StartTime, EndTime, Field, Low, High);
+	printf_P(PSTR("%u matches\n"), Matches);
+	return 0;
+}
+
+//Print the hourly or daily rollups
+static int _F16_Handler (void)
+{
+	uint8_t Tier				= argAsInt(1);
+	uint16_t NumberOfRollups	= argAsInt(2);
+	
+	if(Tier == 1)
+	{
+		Datalogger_PrintRollups(DATALOGGER_ROLLUP_HOURLY, NumberOfRollups);
+	}
+	else if(Tier == 2)
+	{
+		Datalogger_PrintRollups(DATALOGGER_ROLLUP_DAILY, NumberOfRollups);
+	}
+	else
+	{
+		printf_P(PSTR("Use 1 for hourly or 2 for daily\n"));
+	}
+	return 0;
+}
+
+//Print the profiling probes
+static int _F17_Handler (void)
+{
+	Profile_Print();
+	if(argAsInt(1) == 1)
+	{
+		Profile_Clear();
+	}
+	return 0;
+}
+
+//Sampling period
+static int _F18_Handler (void)
+{
+	uint8_t Function	= argAsInt(1);
+	uint32_t PeriodMS	= argAsInt(2);
+	
+	if(Function == 1)
+	{
+		if(Sampler_SetPeriod(PeriodMS) == 0)
+		{
+			printf_P(PSTR("The period must be 0 or at least %u ms\n"), SAMPLER_MIN_PERIOD_MS);
+			return 0;
+		}
+	}
+	else if(Function == 2)
+	{
+		Sampler_ClearMisses();
+	}
+	
+	printf_P(PSTR("Period: %lu ms\n"), Sampler_GetPeriod());
+	printf_P(PSTR("Missed: %u\n"), Sampler_GetMisses());
+	return 0;
+}
+
 /** @} */
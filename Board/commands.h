@@ -41,6 +41,9 @@
 extern const uint8_t NumCommands;
 extern const CommandListItem AppCommandList[];
 
+/** Finish the sample started by the 'data' command and print it. Call this often until DataSetBusy returns 0. */
+void Commands_PollDataSet(void);
+
 #endif
 
 /** @} */
\ No newline at end of file
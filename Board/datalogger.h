@@ -29,22 +29,102 @@
 #include "stdint.h"
 
 
-#define DATALOGGER_PAGE_SIZE			528		//This should be the same as the dataflash page size.
 #define DATALOGGER_DATASET_SIZE			18
-#define DATALOGGER_USE_CRC				0
+#define DATALOGGER_TIME_SIZE			4		//The first bytes of each data set are the time stamp, seconds since HARDWARE_EPOCH_YEAR, big endian
+#define DATALOGGER_USE_CRC				0		//Add a CRC-8 to each data set. This is only used with the fixed schema.
+//Compression is off by default because data sets can not be counted or read by number with the get command when it is on,
+//and DATALOGGER_USE_CRC has no effect. It fits about 2.2 times as many data sets in a page at a 1 minute period, and 1.7 times at 10 minutes.
+#define DATALOGGER_USE_COMPRESSION		0		//Delta encode the data sets (DATALOGGER_SCHEMA_DELTA)
+#define DATALOGGER_CHECKPOINT_SLOTS		16		//Number of EEPROM slots the write cursor checkpoint is rotated through
+#define DATALOGGER_CHECKPOINT_INTERVAL	64		//Pages between checkpoints. Use a multiple of AT45DB321D_PAGES_PER_BLOCK so the checkpoints land on erase blocks.
+#define DATALOGGER_ERASE_AHEAD_BLOCKS	2		//Number of blocks to keep erased in front of the page being written
+#define DATALOGGER_VERIFY_WRITES		0		//Compare each full page with its buffer after it is written. The next page waits for the write to finish.
+#define DATALOGGER_WRITE_RETRIES		2		//Number of times a page that does not verify is written again before it is skipped
+#define DATALOGGER_WRITE_RELOCATIONS	2		//Number of pages in a row that can be skipped before the data is left in a bad page
+
+//Page size and page count
+//These come from the dataflash driver at startup, so the log fills whichever AT45DB part is fitted.
+
+//Rollups
+//Hourly and daily totals of the zone map fields are kept in their own rings of pages at the end of the dataflash. The log uses the rest.
+//The number of records in a page depends on the page size, with 528 byte pages there are 12.
+#define DATALOGGER_ROLLUP_HOURLY_PAGES	64		//About a month of hourly rollups with 528 byte pages
+#define DATALOGGER_ROLLUP_DAILY_PAGES	32		//About a year of daily rollups with 528 byte pages. The total must be a multiple of the block size.
+#define DATALOGGER_ROLLUP_HOURLY		0
+#define DATALOGGER_ROLLUP_DAILY			1
+
+//Rollup record. The records are packed into the rollup pages with no page header.
+//	0		DATALOGGER_ROLLUP_MAGIC
+//	1-2		Sequence number, big endian. Each record in a ring gets the next number.
+//	3-6		Time stamp of the start of the hour or day, big endian
+//	7-8		Number of data sets, big endian
+//	9-40	Sum (32-bit), min and max (16-bit) of each zone map field, big endian
+//	41		CRC-8 of bytes 0-40
+#define DATALOGGER_ROLLUP_MAGIC			0xB6
+#define DATALOGGER_ROLLUP_RECORD_SIZE	42
+
+//Binary dump frame
+#define DATALOGGER_DUMP_SYNC1			'E'
+#define DATALOGGER_DUMP_SYNC2			'D'
+#define DATALOGGER_DUMP_VERSION			6
+#define DATALOGGER_DUMP_CHUNK			32		//Bytes read from the dataflash at a time. The USB ring buffer packs them into full packets.
+
+//Page layout
+//Each page starts with a header. The data sets follow the header with a fixed stride, so data set k starts at
+//DATALOGGER_PAGE_HEADER_SIZE + k*stride. The header is:
+//	0		DATALOGGER_PAGE_MAGIC
+//	1		DATALOGGER_PAGE_VERSION
+//	2-5		Page sequence number, big endian
+//	6		Schema ID
+//	7		Stride of the data sets in bytes, 0 if the data sets do not have a fixed size
+//	8		Number of data sets in the page
+//	9-12	Time stamp of the first data set in the page
+//	13-16	Time stamp of the last data set in the page
+//	17-32	Zone map, the min and max of each zone map field in the page. These are 16-bit big endian values, min first.
+//	33-34	Address in the page after the last data set, big endian
+//	35		CRC-8 of bytes 0-34
+#define DATALOGGER_PAGE_HEADER_SIZE		36
+#define DATALOGGER_PAGE_MAGIC			0xD1
+#define DATALOGGER_PAGE_VERSION			4
+#define DATALOGGER_SCHEMA_FIXED			0x01	//Data sets are stored as they were passed to Datalogger_AddDataSet
+#define DATALOGGER_SCHEMA_DELTA			0x02	//The first data set in the page is stored in full, the rest are delta encoded
+
+//Delta encoding
+//A data set is treated as nine 16-bit big endian words: the high and low words of the time stamp and the seven sensor readings.
+//A delta encoded data set is a flag byte followed by the changes from the data set before it:
+//	- Bit 7 of the flag byte is set if the high time word changed. The change is stored first.
+//	- The change in the low time word is always stored.
+//	- Bits 0-6 of the flag byte are set if sensor readings 0-6 changed. The changes are stored in order.
+//Each change is the difference between the words as a signed 16-bit value, zig-zag encoded ((d << 1) ^ (d >> 15)) and
+//stored as a varint: 7 bits per byte, least significant first, bit 7 set if more bytes follow.
+#define DATALOGGER_MAX_RECORD_SIZE		28		//Flag byte plus nine 3 byte varints
+
+//Data set fields used by the zone map and by Datalogger_Query. Temperature, RH and pressure are signed.
+//The time stamps are seconds since HARDWARE_EPOCH_YEAR, so they compare in time order.
+#define DATALOGGER_FIELD_TIME			0		//Only match on time
+#define DATALOGGER_FIELD_TEMPERATURE	1
+#define DATALOGGER_FIELD_RH				2
+#define DATALOGGER_FIELD_PRESSURE		3
+#define DATALOGGER_FIELD_CLEAR			4
+#define DATALOGGER_ZONE_FIELDS			4		//Number of fields in the zone map, starting at DATALOGGER_FIELD_TEMPERATURE
+
+#if DATALOGGER_USE_COMPRESSION == 1
+#define DATALOGGER_SCHEMA				DATALOGGER_SCHEMA_DELTA
+#else
+#define DATALOGGER_SCHEMA				DATALOGGER_SCHEMA_FIXED
+#endif
 
 
 //Initalization options
+//The log is a ring. When the device is full, the oldest pages are overwritten.
 #define DATALOGGER_INIT_APPEND				0x01		//Search for previously written data and append.
 #define DATALOGGER_INIT_OVERWRITE			0x02		//Restart data collection at page 0, address 0.
-#define DATALOGGER_INIT_RESTART_IF_FULL		0x04		//If the device is full, restart data collection at page 0, address 0.
+#define DATALOGGER_INIT_RESTART_IF_FULL		0x04		//If the device is full, keep going and overwrite the oldest data.
 #define DATALOGGER_INIT_STOP_IF_FULL		0x08		//If the device is full, do not start collecting data.
 
 
 
 
-#define DATALOGGER_HEADER1_PREFIX	0xA0
-#define DATALOGGER_HEADER2_SUFFIX	0x00
 //TODO: Add exclude sectors
 
 /*typedef struct 
@@ -71,17 +151,70 @@ void Datalogger_Init(uint8_t SetupByte);
 /** Add a set of data to be saved. This function will automatically write the data to flash when a page gets full.*/
 void Datalogger_AddDataSet(uint8_t DataSet[]);
 
+/** Background work for the datalogger. Call this from the main loop.
+ *	When the dataflash is idle, this erases blocks in front of the page being written so that full pages can be written without the built in erase.
+ */
+void Datalogger_Task(void);
+
 /** Save a partial set of data to flash. Call this if the controller needs to be reset. */
 void Datalogger_SaveDataToFlash(void);
 
-/** Locate the last set of data written to flash */
-void Datalogger_FindLastDataSet(uint16_t *PageNumber, uint16_t *AddressInPage);
+/** Locate the last set of data written to flash.
+ *  Each page header holds a sequence number. The number goes up by one for every page, so a binary search finds the newest page, even after the log has wrapped.
+ *	The end of the data in that page comes from its header. PageSequence is set to the sequence number of the page at the returned location.
+ */
+void Datalogger_FindLastDataSet(uint16_t *PageNumber, uint16_t *AddressInPage, uint32_t *PageSequence);
 
-/** Writes a given number of datasets to the screen using prinf */
+/** Save the current write cursor to the next EEPROM checkpoint slot.
+ *  This is called when a page that starts every DATALOGGER_CHECKPOINT_INTERVAL pages is started, and when a partial page is saved. The slots are used
+ *	in rotation to spread out EEPROM wear. At startup the cursor is rolled forward from the checkpoint over the pages written since.
+ */
+void Datalogger_SaveCheckpoint(void);
+
+/** Load the newest valid write cursor checkpoint from EEPROM.
+ *  Returns 1 if a valid checkpoint was found, 0 otherwise.
+ */
+uint8_t Datalogger_LoadCheckpoint(uint16_t *PageNumber, uint16_t *AddressInPage);
+
+/** Writes a given number of datasets to the screen using prinf, starting with the oldest data set */
 void Datalogger_ReadBackData(uint16_t NumberOfDataSets);
 
-//how to do this?
-uint8_t Datalogger_RetrieveDataFromFlash(uint16_t *DataPageNumber, uint16_t DataNumberInPage, uint8_t DataSet[]);
+/** Send all of the logged data to the host as a single binary frame over the USB CDC interface.
+ *	The frame is:
+ *	- Sync bytes DATALOGGER_DUMP_SYNC1 and DATALOGGER_DUMP_SYNC2, and DATALOGGER_DUMP_VERSION.
+ *	- Page size, first page, number of full pages and number of bytes in the last page. These are 16-bit big endian values.
+ *	- The raw page data, starting at the oldest page and wrapping from the last page of the log to page 0. Each page starts with its page header.
+ *	  Delta encoded pages are sent as they are stored, the host decodes them. Pages left erased by a failed write have no header and are skipped.
+ *	- A CRC-16 (polynomial 0xA001, initial value 0xFFFF) of the page data, big endian.
+ */
+void Datalogger_DumpData(void);
+
+/** Print the data sets with a time stamp from 'StartTime' to 'EndTime', and a value of field 'Field' from 'Low' to 'High'.
+ *	Times are in seconds since HARDWARE_EPOCH_YEAR, the same as the first four bytes of a data set. 'Field' is one of the DATALOGGER_FIELD_ values, DATALOGGER_FIELD_TIME matches any value.
+ *	The pages are in time order, so the first page is found with a binary search on the page headers. Pages are only read if the zone map in their header
+ *	shows that they can have matching data sets.
+ *	Returns the number of matching data sets.
+ */
+uint16_t Datalogger_Query(uint32_t StartTime, uint32_t EndTime, uint8_t Field, int32_t Low, int32_t High);
+
+/** Print the newest 'NumberOfRollups' hourly or daily rollups, oldest first. 'Tier' is DATALOGGER_ROLLUP_HOURLY or DATALOGGER_ROLLUP_DAILY.
+ *	Each line has the time, the number of data sets, then the average, min and max of each zone map field.
+ *	The hour or day in progress is only in RAM, and is not printed.
+ */
+void Datalogger_PrintRollups(uint8_t Tier, uint16_t NumberOfRollups);
+
+/** Returns the number of data sets in the log. Data sets are numbered from 0, starting with the oldest.
+ *	Data sets can only be counted and retrieved by number with the fixed schema, this returns 0 if DATALOGGER_USE_COMPRESSION is set.
+ */
+uint32_t Datalogger_GetDataSetCount(void);
+
+/** Read data set number 'DataSetNumber' into 'DataSet', which must hold DATALOGGER_DATASET_SIZE bytes.
+ *	Every page before the page being written is full, so the page and address of the data set are calculated directly. A page that was
+ *	relocated by a failed write is found by stepping over the erased pages. The data set is read with a main memory page read, so neither
+ *	SRAM buffer is changed.
+ *	Returns 1 if the data set was read, 0 if it does not exist.
+ */
+uint8_t Datalogger_RetrieveDataFromFlash(uint32_t DataSetNumber, uint8_t DataSet[]);
 
 
 
@@ -43,6 +43,8 @@
 #define MPL115AL_REG_CAL_C12_LSB		0x0B
 #define MPL115AL_REG_CONVERT			0x12
 
+#define MPL115A1_CONVERSION_MS			4		//Time from starting a conversion to the result being ready (3ms max, plus one for the tick)
+
 void MPL115A1_Init(void);
 void MPL115A1_Select(void);
 void MPL115A1_Deselect(void);
@@ -53,5 +55,14 @@ void MPL115A1_GetCalData(int16_t *A0, int16_t *B1, int16_t *B2, int16_t *C12);
 void MPL115A1_GetConversion(uint16_t *PressureData, uint16_t *TemperatureData);
 void MPL115A1_GetPressure(int16_t *Pressure_kPa);
 
+/** Start a pressure and temperature conversion and return right away. Read the result with MPL115A1_ReadConversion after MPL115A1_CONVERSION_MS. */
+void MPL115A1_StartConversion(void);
+
+/** Read the raw 10-bit pressure and temperature values of the last conversion */
+void MPL115A1_ReadConversion(uint16_t *PressureData, uint16_t *TemperatureData);
+
+/** Returns the temperature compensated pressure for raw conversion values, in kPa with a four bit fraction */
+int16_t MPL115A1_CompensatePressure(uint16_t Padc, uint16_t Tadc);
+
 #endif
 /** @} */
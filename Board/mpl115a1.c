@@ -81,7 +81,7 @@ void MPL115A1_GetCalData(int16_t *A0, int16_t *B1, int16_t *B2, int16_t *C12)
 	//uint8_t tempData;
 	
 	//TODO: remove this line later?
-	InitSPIMaster(0,0);
+	SPIInit();
 	//SPI_Init(SPI_SPEED_FCPU_DIV_2 | SPI_ORDER_MSB_FIRST | SPI_SCK_LEAD_RISING | SPI_SAMPLE_LEADING | SPI_MODE_MASTER);
 		
 	MPL115A1_Select();
@@ -112,7 +112,15 @@ void MPL115A1_GetCalData(int16_t *A0, int16_t *B1, int16_t *B2, int16_t *C12)
 
 void MPL115A1_GetConversion(uint16_t *PressureData, uint16_t *TemperatureData)
 {
-	InitSPIMaster(0,0);
+	MPL115A1_StartConversion();
+	DelayMS(MPL115A1_CONVERSION_MS);
+	MPL115A1_ReadConversion(PressureData, TemperatureData);
+	return;
+}
+
+void MPL115A1_StartConversion(void)
+{
+	SPIInit();
 	//SPI_Init(SPI_SPEED_FCPU_DIV_2 | SPI_ORDER_MSB_FIRST | SPI_SCK_LEAD_RISING | SPI_SAMPLE_LEADING | SPI_MODE_MASTER);
 	
 	//Start conversions
@@ -120,9 +128,11 @@ void MPL115A1_GetConversion(uint16_t *PressureData, uint16_t *TemperatureData)
 	SPISendByte(MPL115AL_REG_CONVERT<<1);
 	SPISendByte(0x00);
 	MPL115A1_Deselect();
-	
-	DelayMS(4);
-	
+	return;
+}
+
+void MPL115A1_ReadConversion(uint16_t *PressureData, uint16_t *TemperatureData)
+{
 	MPL115A1_Select();
 	SPISendByte(0x80 | (MPL115AL_REG_PRESSURE_MSB << 1));
 	*PressureData = (SPISendByte(0x00) << 8);
@@ -150,18 +160,24 @@ void MPL115A1_GetConversion(uint16_t *PressureData, uint16_t *TemperatureData)
 */
 void MPL115A1_GetPressure(int16_t *Pressure_kPa)
 {
-	int32_t c12x2, a1, a1x1, y1, a2x2, PComp;
 	uint16_t Padc;
 	uint16_t Tadc;
 
+	//Get temperature and pressure conversion from the device
+	MPL115A1_GetConversion(&Padc, &Tadc);
+	*Pressure_kPa = MPL115A1_CompensatePressure(Padc, Tadc);
+	return;
+}
+
+int16_t MPL115A1_CompensatePressure(uint16_t Padc, uint16_t Tadc)
+{
+	int32_t c12x2, a1, a1x1, y1, a2x2, PComp;
+
 	//Check if the cal data has been captured.
 	if((MPL115A1_CAL_A0 == 0) || (MPL115A1_CAL_B1 == 0) || (MPL115A1_CAL_B2 == 0) || (MPL115A1_CAL_C12 == 0) )
 	{
 		MPL115A1_UpdateCalData();
 	}
-
-	//Get temperature and pressure conversion from the device
-	MPL115A1_GetConversion(&Padc, &Tadc);
 	
 	//These calculations are stolen from application note AN3785 from Freescale.
 	//Pcomp has an 8-bit integer portion and a four bit fractional portion
@@ -172,8 +188,7 @@ void MPL115A1_GetPressure(int16_t *Pressure_kPa)
 	a2x2 = (((int32_t)MPL115A1_CAL_B2) * Tadc) >> 1; 		// a2x2 = b2 * Tadc
 	PComp = (y1 + a2x2) >> 9; 								// PComp = y1 + a2x2
 
-	*Pressure_kPa = (((((int32_t)PComp) * 1041) >> 14) + 800);
-	return;
+	return (int16_t)(((((int32_t)PComp) * 1041) >> 14) + 800);
 }
 
 /** @} */
\ No newline at end of file
@@ -0,0 +1,146 @@
+/*   This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** \file
+*	\brief		Profiling probes.
+*	\author		Pat Satyshur
+*	\version	1.0
+*	\date		2/17/2013
+*	\copyright	Copyright 2013, Pat Satyshur
+*	\ingroup 	hardware
+*
+*	@{
+*/
+
+#include "main.h"
+
+#if PROFILE_ENABLE == 1
+//The names are also the format strings used to print them, so they can not have a '%'
+static const char ProfileNames[PROFILE_PROBES][12] PROGMEM =
+{
+	"GetDataSet",
+	"AddDataSet",
+	"CommitPage",
+	"SaveData",
+};
+
+//Times are in fine ticks
+typedef struct
+{
+	uint16_t Count;
+	uint32_t Min;
+	uint32_t Max;
+	uint32_t Total;
+	uint8_t Histogram[PROFILE_HISTOGRAM_BINS];
+} ProfileProbe;
+
+static ProfileProbe ProfileProbes[PROFILE_PROBES];
+#endif
+
+void Profile_Record(uint8_t Probe, uint32_t StartTime)
+{
+#if PROFILE_ENABLE == 1
+	uint32_t Elapsed = GetTickFine() - StartTime;
+	ProfileProbe *ThisProbe;
+	uint32_t Scaled;
+	uint8_t Bin;
+	
+	if(Probe >= PROFILE_PROBES)
+	{
+		return;
+	}
+	ThisProbe = &ProfileProbes[Probe];
+	
+	//Counts stop at the max instead of wrapping
+	if(ThisProbe->Count < 0xFFFF)
+	{
+		ThisProbe->Count++;
+	}
+	if((ThisProbe->Count == 1) || (Elapsed < ThisProbe->Min))
+	{
+		ThisProbe->Min = Elapsed;
+	}
+	if(Elapsed > ThisProbe->Max)
+	{
+		ThisProbe->Max = Elapsed;
+	}
+	ThisProbe->Total += Elapsed;
+	
+	//The bin is the position of the highest set bit, less the shift
+	Bin = 0;
+	Scaled = Elapsed >> (PROFILE_HISTOGRAM_SHIFT + 1);
+	while((Scaled > 0) && (Bin < (PROFILE_HISTOGRAM_BINS - 1)))
+	{
+		Scaled = Scaled >> 1;
+		Bin++;
+	}
+	if(ThisProbe->Histogram[Bin] < 0xFF)
+	{
+		ThisProbe->Histogram[Bin]++;
+	}
+#endif
+	return;
+}
+
+void Profile_Print(void)
+{
+#if PROFILE_ENABLE == 1
+	uint8_t i;
+	uint8_t j;
+	ProfileProbe *ThisProbe;
+	
+	for(i=0; i<PROFILE_PROBES; i++)
+	{
+		ThisProbe = &ProfileProbes[i];
+		if(ThisProbe->Count == 0)
+		{
+			continue;
+		}
+		
+		printf_P(ProfileNames[i]);
+		printf_P(PSTR(": %u, min %lu us, avg %lu us, max %lu us, total %lu ms\n"), ThisProbe->Count, ThisProbe->Min*TICK_FINE_US,
+					(ThisProbe->Total/ThisProbe->Count)*TICK_FINE_US, ThisProbe->Max*TICK_FINE_US, ThisProbe->Total/(1000/TICK_FINE_US));
+		
+		//Histogram, only the bins that have counts
+		for(j=0; j<PROFILE_HISTOGRAM_BINS; j++)
+		{
+			if(ThisProbe->Histogram[j] == 0)
+			{
+				continue;
+			}
+			if(j == 0)
+			{
+				printf_P(PSTR("  <%lu us: %u\n"), ((uint32_t)1<<(PROFILE_HISTOGRAM_SHIFT + 1))*TICK_FINE_US, ThisProbe->Histogram[j]);
+			}
+			else
+			{
+				printf_P(PSTR("  >=%lu us: %u\n"), ((uint32_t)1<<(j + PROFILE_HISTOGRAM_SHIFT))*TICK_FINE_US, ThisProbe->Histogram[j]);
+			}
+		}
+	}
+#else
+	printf_P(PSTR("Profiling is off\n"));
+#endif
+	return;
+}
+
+void Profile_Clear(void)
+{
+#if PROFILE_ENABLE == 1
+	memset(ProfileProbes, 0, sizeof(ProfileProbes));
+#endif
+	return;
+}
+
+/** @} */
@@ -0,0 +1,64 @@
+/*   This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** \file
+*	\brief		Header file for the profiling probes.
+*	\author		Pat Satyshur
+*	\version	1.0
+*	\date		2/17/2013
+*	\copyright	Copyright 2013, Pat Satyshur
+*	\ingroup 	hardware
+*
+*	@{
+*/
+
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include "stdint.h"
+
+#define PROFILE_ENABLE				0		//Set to 1 to add the probes. They use 104 bytes of SRAM.
+
+//Probes. Add a name for each one to ProfileNames in profile.c.
+#define PROFILE_GETDATASET			0		//Taking a sample of the sensors, from StartDataSet to the data set being filled in
+#define PROFILE_ADDDATASET			1		//Adding a data set to the log, including any page commit
+#define PROFILE_COMMITPAGE			2		//Writing a full buffer to the dataflash
+#define PROFILE_SAVEDATA			3		//Writing a partial page to the dataflash and waiting for it
+#define PROFILE_PROBES				4
+
+#define PROFILE_HISTOGRAM_BINS		12		//Bin n counts times from 2^(n+SHIFT) to 2^(n+SHIFT+1)-1 fine ticks. Bin 0 also counts shorter times and the last bin longer ones.
+#define PROFILE_HISTOGRAM_SHIFT		4		//Bin 0 is under 256us and the last bin is 262ms and up, which covers a page erase and program
+
+#if PROFILE_ENABLE == 1
+/** Start timing a section of code. This declares 'StartVar' to hold the start time. */
+#define PROFILE_START(StartVar)			uint32_t StartVar = GetTickFine()
+
+/** Stop timing a section of code and add the time to probe 'Probe' */
+#define PROFILE_STOP(Probe, StartVar)	Profile_Record((Probe), (StartVar))
+#else
+#define PROFILE_START(StartVar)
+#define PROFILE_STOP(Probe, StartVar)
+#endif
+
+/** Add the time from 'StartTime' to now to a probe. 'StartTime' is from GetTickFine. */
+void Profile_Record(uint8_t Probe, uint32_t StartTime);
+
+/** Print the count, min, average, max and total time, and the histogram of each probe that has been hit */
+void Profile_Print(void);
+
+/** Clear all of the probes */
+void Profile_Clear(void);
+
+#endif
+/** @} */
@@ -0,0 +1,113 @@
+/*   This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** \file
+*	\brief		Periodic sampling task.
+*	\author		Pat Satyshur
+*	\version	1.0
+*	\date		2/17/2013
+*	\copyright	Copyright 2013, Pat Satyshur
+*	\ingroup 	hardware
+*
+*	@{
+*/
+
+#include "main.h"
+
+static uint32_t SamplerPeriodMS = SAMPLER_DEFAULT_PERIOD_MS;
+static uint32_t SamplerDeadline = SAMPLER_DEFAULT_PERIOD_MS;	//Tick of the next sample
+static uint16_t SamplerMisses;
+static uint8_t SamplerDataSet[DATALOGGER_DATASET_SIZE];
+
+uint8_t Sampler_Task(SchedulerTask *Task)
+{
+	static uint8_t stat;
+	uint32_t Now;
+	uint32_t Missed;
+	
+	SCHEDULER_TASK_BEGIN(Task);
+	while(1)
+	{
+		//Wait for the data command to finish its sample as well
+		SCHEDULER_TASK_WAIT_UNTIL(Task, (SamplerPeriodMS != 0) && ((int32_t)(GetTickMS() - SamplerDeadline) >= 0) && (DataSetBusy() == 0));
+		
+		//The other tasks run while the sensors convert
+		stat = StartDataSet();
+		while(stat == DATASET_STATUS_BUSY)
+		{
+			SCHEDULER_TASK_YIELD(Task);
+			stat = PollDataSet(SamplerDataSet);
+		}
+		
+		if(stat == DATASET_STATUS_OK)
+		{
+			Datalogger_AddDataSet(SamplerDataSet);
+		}
+		else
+		{
+			printf_P(PSTR("Sample failed: %u\n"), stat);
+		}
+		
+		//The next deadline is one period after the last deadline, not after the sample.
+		//The period can not change during the sample, because CommandTask holds the period command until DataSetBusy returns 0.
+		SamplerDeadline += SamplerPeriodMS;
+		Now = GetTickMS();
+		if((int32_t)(Now - SamplerDeadline) >= 0)
+		{
+			//Skip the deadlines that have passed instead of taking the samples back to back
+			Missed = ((Now - SamplerDeadline) / SamplerPeriodMS) + 1;
+			SamplerDeadline += Missed * SamplerPeriodMS;
+			if((SamplerMisses + Missed) > 0xFFFF)
+			{
+				SamplerMisses = 0xFFFF;
+			}
+			else
+			{
+				SamplerMisses += Missed;
+			}
+			printf_P(PSTR("Missed %lu samples\n"), Missed);
+		}
+	}
+	SCHEDULER_TASK_END(Task);
+}
+
+uint8_t Sampler_SetPeriod(uint32_t PeriodMS)
+{
+	if((PeriodMS != 0) && (PeriodMS < SAMPLER_MIN_PERIOD_MS))
+	{
+		return 0;
+	}
+	
+	SamplerPeriodMS = PeriodMS;
+	SamplerDeadline = GetTickMS() + PeriodMS;
+	return 1;
+}
+
+uint32_t Sampler_GetPeriod(void)
+{
+	return SamplerPeriodMS;
+}
+
+uint16_t Sampler_GetMisses(void)
+{
+	return SamplerMisses;
+}
+
+void Sampler_ClearMisses(void)
+{
+	SamplerMisses = 0;
+	return;
+}
+
+/** @} */
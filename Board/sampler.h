@@ -0,0 +1,55 @@
+/*   This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** \file
+*	\brief		Header file for the periodic sampling task.
+*	\author		Pat Satyshur
+*	\version	1.0
+*	\date		2/17/2013
+*	\copyright	Copyright 2013, Pat Satyshur
+*	\ingroup 	hardware
+*
+*	@{
+*/
+
+#ifndef _SAMPLER_H_
+#define _SAMPLER_H_
+
+#include "stdint.h"
+
+#define SAMPLER_DEFAULT_PERIOD_MS	300000UL	//Five minutes
+#define SAMPLER_MIN_PERIOD_MS		200			//A sample takes about 90 ms, plus the time to add it to the log
+
+/** Scheduler task that takes a sample every period and adds it to the log.
+ *	The sample times are whole periods after the first one, so they do not drift with the time it takes to run the task. If a sample
+ *	is so late that the next deadline has passed, the missed deadlines are skipped and counted.
+ */
+uint8_t Sampler_Task(SchedulerTask *Task);
+
+/** Set the sampling period in ms, 0 stops sampling. The next sample is taken one period from now.
+ *	Returns 1 if the period was set, 0 if it is shorter than SAMPLER_MIN_PERIOD_MS.
+ */
+uint8_t Sampler_SetPeriod(uint32_t PeriodMS);
+
+/** Returns the sampling period in ms, 0 if sampling is stopped */
+uint32_t Sampler_GetPeriod(void);
+
+/** Returns the number of deadlines that have been missed */
+uint16_t Sampler_GetMisses(void);
+
+/** Clear the number of missed deadlines */
+void Sampler_ClearMisses(void);
+
+#endif
+/** @} */
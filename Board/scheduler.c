@@ -0,0 +1,79 @@
+/*   This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** \file
+*	\brief		Cooperative task scheduler.
+*	\author		Pat Satyshur
+*	\version	1.0
+*	\date		2/17/2013
+*	\copyright	Copyright 2013, Pat Satyshur
+*	\ingroup 	hardware
+*
+*	@{
+*/
+
+#include "main.h"
+
+SchedulerFunction SchedulerFunctions[SCHEDULER_MAX_TASKS];	//0 if the slot is free
+SchedulerTask SchedulerTasks[SCHEDULER_MAX_TASKS];
+
+uint8_t Scheduler_AddTask(SchedulerFunction Function)
+{
+	uint8_t i;
+	
+	for(i=0; i<SCHEDULER_MAX_TASKS; i++)
+	{
+		if(SchedulerFunctions[i] == 0)
+		{
+			SchedulerTasks[i].Resume = 0;
+			SchedulerTasks[i].WakeTime = GetTickMS();
+			SchedulerFunctions[i] = Function;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+void Scheduler_Run(void)
+{
+	uint8_t i;
+	
+	for(i=0; i<SCHEDULER_MAX_TASKS; i++)
+	{
+		if(SchedulerFunctions[i] == 0)
+		{
+			continue;
+		}
+		
+		//The tick count wraps, so compare the difference
+		if((int32_t)(GetTickMS() - SchedulerTasks[i].WakeTime) < 0)
+		{
+			continue;
+		}
+		
+		if(SchedulerFunctions[i](&SchedulerTasks[i]) == SCHEDULER_TASK_DONE)
+		{
+			SchedulerFunctions[i] = 0;
+		}
+	}
+	return;
+}
+
+void Scheduler_Sleep(SchedulerTask *Task, uint16_t ms)
+{
+	Task->WakeTime = GetTickMS() + ms;
+	return;
+}
+
+/** @} */
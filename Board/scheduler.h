@@ -0,0 +1,68 @@
+/*   This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** \file
+*	\brief		Header file for the cooperative task scheduler.
+*	\author		Pat Satyshur
+*	\version	1.0
+*	\date		2/17/2013
+*	\copyright	Copyright 2013, Pat Satyshur
+*	\ingroup 	hardware
+*
+*	@{
+*/
+
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+#include "stdint.h"
+
+#define SCHEDULER_MAX_TASKS			6
+
+//Task return values
+#define SCHEDULER_TASK_WAITING		0		//Run the task again
+#define SCHEDULER_TASK_DONE			1		//Remove the task from the scheduler
+
+/** State of a task. The scheduler keeps one of these for each task and passes it to the task function. */
+typedef struct
+{
+	uint16_t Resume;		//Where the task picks up the next time it runs, 0 to start at the top
+	uint32_t WakeTime;		//The task is not run until the tick count from GetTickMS reaches this
+} SchedulerTask;
+
+typedef uint8_t (*SchedulerFunction)(SchedulerTask *Task);
+
+//Protothread style tasks.
+//A task function starts with SCHEDULER_TASK_BEGIN and ends with SCHEDULER_TASK_END. In between it can give up the CPU with the yield, wait and
+//sleep macros, and it carries on from the same place the next time the scheduler runs it. Local variables are not kept when a task gives up
+//the CPU, so make them static. Only one of these macros can go on a line, and they can not be used inside a switch statement.
+#define SCHEDULER_TASK_BEGIN(Task)				switch((Task)->Resume) { case 0:
+#define SCHEDULER_TASK_END(Task)				} (Task)->Resume = 0; return SCHEDULER_TASK_DONE
+#define SCHEDULER_TASK_YIELD(Task)				do { (Task)->Resume = __LINE__; return SCHEDULER_TASK_WAITING; case __LINE__:; } while(0)
+#define SCHEDULER_TASK_WAIT_UNTIL(Task, Cond)	do { (Task)->Resume = __LINE__; case __LINE__: if(!(Cond)) { return SCHEDULER_TASK_WAITING; } } while(0)
+#define SCHEDULER_TASK_SLEEP(Task, ms)			do { Scheduler_Sleep((Task), (ms)); SCHEDULER_TASK_YIELD(Task); } while(0)
+
+/** Add a task. 'Function' is called by Scheduler_Run until it returns SCHEDULER_TASK_DONE.
+ *	Returns 1 if the task was added, 0 if there are already SCHEDULER_MAX_TASKS tasks.
+ */
+uint8_t Scheduler_AddTask(SchedulerFunction Function);
+
+/** Run each task that is not asleep once. Call this from the main loop. */
+void Scheduler_Run(void);
+
+/** Do not run 'Task' again for 'ms' milliseconds. Use SCHEDULER_TASK_SLEEP from inside a task. */
+void Scheduler_Sleep(SchedulerTask *Task, uint16_t ms);
+
+#endif
+/** @} */
@@ -84,34 +84,45 @@ uint8_t SHT25_WriteUserReg(uint8_t RegValue)
 //TODO: Does the big buffer need to be 32 bits?
 uint8_t SHT25_ReadTemp(int16_t *TempValue)
 {
-	int32_t BigBuffer;
-	uint16_t SmallBuffer;
-	uint8_t DataToSend;
-	uint8_t DataToReceive[3];
 	uint8_t stat;
 	uint8_t i;
 
-	DataToSend = SHT25_READ_TEMP_NOHOLD;
-
 	//Start temperature conversion
-	stat = I2CSoft_RW(SHT25_I2C_ADDR, &DataToSend, NULL, 1, 0);
+	SHT25_StartTemp();
 	
 	//Wait for response
-	DelayMS(75);
+	DelayMS(SHT25_TEMP_CONVERSION_MS);
 	for(i=0; i<20; i++)
 	{
-		stat = I2CSoft_RW(SHT25_I2C_ADDR, NULL, DataToReceive, 0, 3);
-		if(stat == SOFT_I2C_STAT_OK)
+		stat = SHT25_GetTemp(TempValue);
+		if(stat != SHT25_RETURN_STATUS_BUSY)
 		{
-			break;
+			return stat;
 		}
-		DelayMS(10);
+		DelayMS(SHT25_POLL_INTERVAL_MS);
 	}
 	
-	if(i >= 20)
+	//Device did not respond
+	return SHT25_RETURN_STATUS_TIMEOUT;
+}
+
+uint8_t SHT25_StartTemp(void)
+{
+	uint8_t DataToSend = SHT25_READ_TEMP_NOHOLD;
+	
+	return I2CSoft_RW(SHT25_I2C_ADDR, &DataToSend, NULL, 1, 0);
+}
+
+uint8_t SHT25_GetTemp(int16_t *TempValue)
+{
+	int32_t BigBuffer;
+	uint16_t SmallBuffer;
+	uint8_t DataToReceive[3];
+
+	//The device does not acknowledge the read until the conversion is done
+	if(I2CSoft_RW(SHT25_I2C_ADDR, NULL, DataToReceive, 0, 3) != SOFT_I2C_STAT_OK)
 	{
-		//Device did not respond
-		return SHT25_RETURN_STATUS_TIMEOUT;
+		return SHT25_RETURN_STATUS_BUSY;
 	}
 
 	SmallBuffer = (DataToReceive[0] << 8) | (DataToReceive[1]);
@@ -129,34 +140,45 @@ uint8_t SHT25_ReadTemp(int16_t *TempValue)
 //TODO: Does the big buffer need to be 32 bits?
 uint8_t SHT25_ReadRH(int16_t *RHValue)
 {
-	uint32_t BigBuffer;
-	uint16_t SmallBuffer;
-	uint8_t DataToSend;
-	uint8_t DataToReceive[3];
 	uint8_t stat;
 	uint8_t i;
 
-	DataToSend = SHT25_READ_RH_NOHOLD;
-
 	//Start RH conversion
-	stat = I2CSoft_RW(SHT25_I2C_ADDR, &DataToSend, NULL, 1, 0);
+	SHT25_StartRH();
 	
 	//Wait for response
-	DelayMS(30);
+	DelayMS(SHT25_RH_CONVERSION_MS);
 	for(i=0; i<20; i++)
 	{
-		stat = I2CSoft_RW(SHT25_I2C_ADDR, NULL, DataToReceive, 0, 3);
-		if(stat == SOFT_I2C_STAT_OK)
+		stat = SHT25_GetRH(RHValue);
+		if(stat != SHT25_RETURN_STATUS_BUSY)
 		{
-			break;
+			return stat;
 		}
-		DelayMS(10);
+		DelayMS(SHT25_POLL_INTERVAL_MS);
 	}
 	
-	if(i >= 20)
+	//Device did not respond
+	return SHT25_RETURN_STATUS_TIMEOUT;
+}
+
+uint8_t SHT25_StartRH(void)
+{
+	uint8_t DataToSend = SHT25_READ_RH_NOHOLD;
+	
+	return I2CSoft_RW(SHT25_I2C_ADDR, &DataToSend, NULL, 1, 0);
+}
+
+uint8_t SHT25_GetRH(int16_t *RHValue)
+{
+	uint32_t BigBuffer;
+	uint16_t SmallBuffer;
+	uint8_t DataToReceive[3];
+
+	//The device does not acknowledge the read until the conversion is done
+	if(I2CSoft_RW(SHT25_I2C_ADDR, NULL, DataToReceive, 0, 3) != SOFT_I2C_STAT_OK)
 	{
-		//Device did not respond
-		return SHT25_RETURN_STATUS_TIMEOUT;
+		return SHT25_RETURN_STATUS_BUSY;
 	}
 
 	SmallBuffer = (DataToReceive[0] << 8) | (DataToReceive[1]);
@@ -61,6 +61,17 @@
 #define SHT25_RETURN_STATUS_OK			0x00
 #define SHT25_RETURN_STATUS_CRC_ERROR	0x01
 #define SHT25_RETURN_STATUS_TIMEOUT		0x02
+#define SHT25_RETURN_STATUS_BUSY		0x03		//The conversion is not done yet
+
+//Conversion times. The device is polled every SHT25_POLL_INTERVAL_MS after this until it answers.
+#define SHT25_TEMP_CONVERSION_MS		75
+#define SHT25_RH_CONVERSION_MS			30
+#define SHT25_POLL_INTERVAL_MS			10
+
+//Typical conversion times. StartDataSet starts polling after these, then polls every SHT25_FAST_POLL_MS.
+#define SHT25_TEMP_TYPICAL_MS			66
+#define SHT25_RH_TYPICAL_MS				22
+#define SHT25_FAST_POLL_MS				2
 
 void SHT25_Init( void );
 uint8_t SHT25_Reset(void);
@@ -70,19 +81,41 @@ uint8_t SHT25_WriteUserReg(uint8_t RegValue);
 uint8_t SHT25_ReadID(uint16_t *SNA, uint32_t *SNB, uint16_t *SNC);
 
 /** Read the temperature from the device
- * Use the no hold method, and poll the device to see when it is done.
+ * Use the no hold method, and poll the device to see when it is done. This waits with DelayMS, so it is only used by the rh command.
+ * Samples use SHT25_StartTemp and SHT25_GetTemp through StartDataSet and PollDataSet.
  * If reading is successful, TempValue will be the temperature in 100*C
  * Returns SHT25_RETURN_STATUS_OK, SHT25_RETURN_STATUS_CRC_ERROR, or SHT25_RETURN_STATUS_TIMEOUT
  */
 uint8_t SHT25_ReadTemp(int16_t *TempValue);
 
 /** Read the relative humidity from the device
- * Use the no hold method, and poll the device to see when it is done.
+ * Use the no hold method, and poll the device to see when it is done. This waits with DelayMS, so it is only used by the rh command.
+ * Samples use SHT25_StartRH and SHT25_GetRH through StartDataSet and PollDataSet.
  * If reading is successful, RHValue will be the relative humidity in 100*%RH
  * Returns SHT25_RETURN_STATUS_OK, SHT25_RETURN_STATUS_CRC_ERROR, or SHT25_RETURN_STATUS_TIMEOUT
  */
 uint8_t SHT25_ReadRH(int16_t *RHValue);
 
+/** Start a temperature conversion and return right away. Read the result with SHT25_GetTemp.
+ * Returns the I2C status of the command.
+ */
+uint8_t SHT25_StartTemp(void);
+
+/** Get the result of a temperature conversion started with SHT25_StartTemp.
+ * Returns SHT25_RETURN_STATUS_BUSY if the conversion is not done yet, otherwise the same as SHT25_ReadTemp.
+ */
+uint8_t SHT25_GetTemp(int16_t *TempValue);
+
+/** Start a relative humidity conversion and return right away. Read the result with SHT25_GetRH.
+ * Returns the I2C status of the command.
+ */
+uint8_t SHT25_StartRH(void);
+
+/** Get the result of a relative humidity conversion started with SHT25_StartRH.
+ * Returns SHT25_RETURN_STATUS_BUSY if the conversion is not done yet, otherwise the same as SHT25_ReadRH.
+ */
+uint8_t SHT25_GetRH(int16_t *RHValue);
+
 //Returns 1 if the data and CRC match, 0 otherwise
 uint8_t SHT25_VerifyCRC(uint16_t DataValue, uint8_t CRCValue);
 
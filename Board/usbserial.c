@@ -0,0 +1,229 @@
+/*   This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** \file
+*	\brief		USB CDC serial buffers.
+*	\author		Pat Satyshur
+*	\version	1.0
+*	\date		2/17/2013
+*	\copyright	Copyright 2013, Pat Satyshur
+*	\ingroup 	hardware
+*
+*	@{
+*/
+
+#include "main.h"
+
+//Receive ring buffer. The head is only written by the USB interrupt and the tail only by the main loop.
+static uint8_t RxBuffer[USBSERIAL_RX_BUFFER_SIZE];
+static volatile uint8_t RxHead;
+static volatile uint8_t RxTail;
+
+//Send ring buffer. The head is only written by the main loop and the tail only by the USB interrupt.
+static uint8_t TxBuffer[USBSERIAL_TX_BUFFER_SIZE];
+static volatile uint8_t TxHead;
+static volatile uint8_t TxTail;
+static volatile uint8_t TxFrameCount;		//Frames since the last packet was sent
+static uint8_t TxNeedZLP;					//The last packet was full, the transfer must be ended with a zero length packet
+static volatile uint8_t TxStalled;			//The host stopped reading, set by the main loop and cleared by the USB interrupt
+
+static uint8_t USBSerial_Connected(void);
+static uint8_t USBSerial_TxPut(uint8_t Data);
+
+void USBSerial_Service(void)
+{
+	uint8_t PrevEndpoint;
+	uint8_t Head;
+	uint8_t Tail;
+	
+	if(USBSerial_Connected() == 0)
+	{
+		//Nobody to send to
+		TxTail = TxHead;
+		return;
+	}
+	
+	//Keep the endpoint selected by the main loop, it may be in the middle of sending data
+	PrevEndpoint = Endpoint_GetCurrentEndpoint();
+	
+	//Move the whole OUT bank into the buffer
+	Endpoint_SelectEndpoint(VirtualSerial_CDC_Interface.Config.DataOUTEndpoint.Address);
+	if(Endpoint_IsOUTReceived())
+	{
+		Head = RxHead;
+		while(Endpoint_BytesInEndpoint() > 0)
+		{
+			if((uint8_t)(Head - RxTail) >= USBSERIAL_RX_BUFFER_SIZE)
+			{
+				//Buffer is full, leave the rest in the bank
+				break;
+			}
+			RxBuffer[Head & (USBSERIAL_RX_BUFFER_SIZE - 1)] = Endpoint_Read_8();
+			Head++;
+		}
+		RxHead = Head;
+		
+		//Only release the bank when it is empty, the host can not send more until then
+		if(Endpoint_BytesInEndpoint() == 0)
+		{
+			Endpoint_ClearOUT();
+		}
+	}
+	
+	//Fill the IN banks. The endpoint is double banked, so one bank can be filled while the host reads the other.
+	Endpoint_SelectEndpoint(VirtualSerial_CDC_Interface.Config.DataINEndpoint.Address);
+	Tail = TxTail;
+	if(TxFrameCount < USBSERIAL_FLUSH_FRAMES)
+	{
+		TxFrameCount++;
+	}
+	while(Endpoint_IsINReady())
+	{
+		while((Tail != TxHead) && (Endpoint_BytesInEndpoint() < CDC_TX_EPSIZE))
+		{
+			Endpoint_Write_8(TxBuffer[Tail & (USBSERIAL_TX_BUFFER_SIZE - 1)]);
+			Tail++;
+		}
+		
+		if(Endpoint_BytesInEndpoint() == CDC_TX_EPSIZE)
+		{
+			//Full packets go right away
+			Endpoint_ClearIN();
+			TxNeedZLP = 1;
+		}
+		else if((TxFrameCount >= USBSERIAL_FLUSH_FRAMES) && ((Endpoint_BytesInEndpoint() > 0) || (TxNeedZLP == 1)))
+		{
+			//Send the rest. This is a short packet, so it also ends the transfer.
+			Endpoint_ClearIN();
+			TxNeedZLP = 0;
+		}
+		else
+		{
+			break;
+		}
+		TxFrameCount = 0;
+		TxStalled = 0;
+	}
+	TxTail = Tail;
+	
+	Endpoint_SelectEndpoint(PrevEndpoint);
+	return;
+}
+
+int USBSerial_PutChar(char c, FILE *Stream)
+{
+	if(USBSerial_TxPut((uint8_t)c) != 0)
+	{
+		return _FDEV_ERR;
+	}
+	return 0;
+}
+
+uint8_t USBSerial_SendData(const uint8_t *Data, uint16_t Length)
+{
+	uint8_t stat = 0;
+	
+	while(Length > 0)
+	{
+		stat |= USBSerial_TxPut(*Data);
+		Data++;
+		Length--;
+	}
+	return stat;
+}
+
+void USBSerial_Flush(void)
+{
+	uint32_t Deadline;
+	
+	//Let the next frame send the packet that is not full
+	TxFrameCount = USBSERIAL_FLUSH_FRAMES;
+	
+	Deadline = GetTickMS() + USBSERIAL_TX_TIMEOUT_MS;
+	while((TxTail != TxHead) && (USBSerial_Connected() == 1))
+	{
+		if((int32_t)(GetTickMS() - Deadline) >= 0)
+		{
+			break;
+		}
+		TxFrameCount = USBSERIAL_FLUSH_FRAMES;
+	}
+	return;
+}
+
+//Returns 1 if the host has opened the port
+static uint8_t USBSerial_Connected(void)
+{
+	if((USB_DeviceState != DEVICE_STATE_Configured) || (VirtualSerial_CDC_Interface.State.LineEncoding.BaudRateBPS == 0))
+	{
+		return 0;
+	}
+	return 1;
+}
+
+//Put a byte in the send buffer, waiting for room if needed. Returns 0 if the byte was buffered, 1 if it was dropped.
+static uint8_t USBSerial_TxPut(uint8_t Data)
+{
+	uint8_t Head = TxHead;
+	uint32_t Deadline;
+	
+	if(USBSerial_Connected() == 0)
+	{
+		return 1;
+	}
+	
+	if((uint8_t)(Head - TxTail) >= USBSERIAL_TX_BUFFER_SIZE)
+	{
+		//Do not wait again until the host has read something
+		if(TxStalled == 1)
+		{
+			return 1;
+		}
+		
+		Deadline = GetTickMS() + USBSERIAL_TX_TIMEOUT_MS;
+		while((uint8_t)(Head - TxTail) >= USBSERIAL_TX_BUFFER_SIZE)
+		{
+			if((int32_t)(GetTickMS() - Deadline) >= 0)
+			{
+				TxStalled = 1;
+				return 1;
+			}
+		}
+	}
+	
+	TxBuffer[Head & (USBSERIAL_TX_BUFFER_SIZE - 1)] = Data;
+	TxHead = Head + 1;
+	return 0;
+}
+
+int16_t USBSerial_ReceiveByte(void)
+{
+	uint8_t Tail = RxTail;
+	int16_t ReceivedByte;
+	
+	if(Tail == RxHead)
+	{
+		return -1;
+	}
+	ReceivedByte = RxBuffer[Tail & (USBSERIAL_RX_BUFFER_SIZE - 1)];
+	RxTail = Tail + 1;
+	return ReceivedByte;
+}
+
+uint8_t USBSerial_BytesReceived(void)
+{
+	return (uint8_t)(RxHead - RxTail);
+}
+
+/** @} */
@@ -0,0 +1,67 @@
+/*   This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** \file
+*	\brief		Header file for the USB CDC serial buffers.
+*	\author		Pat Satyshur
+*	\version	1.0
+*	\date		2/17/2013
+*	\copyright	Copyright 2013, Pat Satyshur
+*	\ingroup 	hardware
+*
+*	@{
+*/
+
+#ifndef _USBSERIAL_H_
+#define _USBSERIAL_H_
+
+#include "stdint.h"
+
+#include <stdio.h>
+
+#define USBSERIAL_RX_BUFFER_SIZE		64		//Must be a power of two, no more than 128
+#define USBSERIAL_TX_BUFFER_SIZE		128		//Must be a power of two, no more than 128
+#define USBSERIAL_FLUSH_FRAMES			4		//A packet that is not full is sent after this many USB frames (ms)
+#define USBSERIAL_TX_TIMEOUT_MS			100		//Time to wait for room in the send buffer before data is dropped
+
+/** Service the CDC interface. This is called from the USB start of frame interrupt every ms once the device is configured.
+ *	All of the data in the OUT endpoint bank is moved into the receive buffer. If the buffer fills up, the rest is left in the
+ *	endpoint and the host waits until there is room.
+ *	Data from the send buffer is packed into the IN endpoint banks. Full packets are sent right away, a packet that is not full is
+ *	sent once no packet has gone out for USBSERIAL_FLUSH_FRAMES frames.
+ */
+void USBSerial_Service(void);
+
+/** Put a character in the send buffer. This is the put function of the stdout stream.
+ *	If the buffer is full, this waits up to USBSERIAL_TX_TIMEOUT_MS for the host to read data. If the host does not, the character is
+ *	dropped and so is the rest of the data until the host reads again.
+ */
+int USBSerial_PutChar(char c, FILE *Stream);
+
+/** Put 'Length' bytes in the send buffer. Waits for room the same way as USBSerial_PutChar.
+ *	Returns 0 if all of the data was buffered, 1 if some of it was dropped.
+ */
+uint8_t USBSerial_SendData(const uint8_t *Data, uint16_t Length);
+
+/** Send the buffered data now instead of waiting for the flush timer, and wait for the buffer to empty. */
+void USBSerial_Flush(void);
+
+/** Returns the next received byte, or -1 if none are waiting. */
+int16_t USBSerial_ReceiveByte(void);
+
+/** Returns the number of received bytes waiting in the buffer */
+uint8_t USBSerial_BytesReceived(void);
+
+#endif
+/** @} */
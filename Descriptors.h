@@ -54,8 +54,13 @@
 		/** Size in bytes of the CDC device-to-host notification IN endpoint. */
 		#define CDC_NOTIFICATION_EPSIZE        8
 
-		/** Size in bytes of the CDC data IN and OUT endpoints. */
-		#define CDC_TXRX_EPSIZE                16
+		/** Size in bytes of the CDC data IN endpoint. This endpoint is double banked. */
+		#define CDC_TX_EPSIZE                  64
+
+		/** Size in bytes of the CDC data OUT endpoint. With the control and notification endpoints, this fills the 176 bytes
+		 *  of endpoint memory in the ATmega32U2.
+		 */
+		#define CDC_RX_EPSIZE                  32
 
 	/* Type Defines: */
 		/** Type define for the device configuration descriptor structure. This must be defined in the
@@ -48,13 +48,13 @@ USB_ClassInfo_CDC_Device_t VirtualSerial_CDC_Interface =
 				.DataINEndpoint           =
 					{
 						.Address          = CDC_TX_EPADDR,
-						.Size             = CDC_TXRX_EPSIZE,
-						.Banks            = 1,
+						.Size             = CDC_TX_EPSIZE,
+						.Banks            = 2,
 					},
 				.DataOUTEndpoint =
 					{
 						.Address          = CDC_RX_EPADDR,
-						.Size             = CDC_TXRX_EPSIZE,
+						.Size             = CDC_RX_EPSIZE,
 						.Banks            = 1,
 					},
 				.NotificationEndpoint =
@@ -66,48 +66,70 @@ USB_ClassInfo_CDC_Device_t VirtualSerial_CDC_Interface =
 			},
 	};
 
-/** Standard file stream for the CDC interface when set up, so that the virtual CDC COM port can be
- *  used like any regular character stream in the C APIs
+/** Standard file stream for the CDC interface, so that the virtual CDC COM port can be
+ *  used like any regular character stream in the C APIs. The data goes through the send buffer in usbserial.c.
  */
-static FILE USBSerialStream;
+static FILE USBSerialStream = FDEV_SETUP_STREAM(USBSerial_PutChar, NULL, _FDEV_SETUP_WRITE);
+
+static uint8_t CommandTask(SchedulerTask *Task);
+static uint8_t DataloggerTask(SchedulerTask *Task);
 
 /** Main program entry point. This routine contains the overall program flow, including initial
  *  setup of all components and the main program loop.
  */
 int main(void)
 {
-	uint8_t DataToSave[18];
-	uint8_t MinToWaitFor = 0;
-	uint8_t MinToSkip = 5;
-	TimeAndDate CurrentTime;
-	
 	HardwareInit();
 
-	/* Create a regular character stream for the interface so that it can be used with the stdio.h functions */
-	CDC_Device_CreateStream(&VirtualSerial_CDC_Interface, &USBSerialStream);
 	stdout = &USBSerialStream;
 
 	LEDs_SetAllLEDs(LEDMASK_USB_NOTREADY);
+	
+	Scheduler_AddTask(CommandTask);
+	Scheduler_AddTask(DataloggerTask);
+	Scheduler_AddTask(Sampler_Task);
 
 	for (;;)
 	{
-		RunCommand();
-		
-		//Determine if it is time to take another data set
-		/*
-		GetTime(&CurrentTime);
-		if(CurrentTime.min == MinToWaitFor)
+		Scheduler_Run();
+	}
+}
+
+/** Pass the received characters to the command parser, and run a command when one has been typed in.
+ *	The commands run to completion, so a command is held until the sample that Sampler_Task or the data command has in progress is done.
+ *	Otherwise the data and SHT25 commands would start their own conversions in the middle of it.
+ */
+static uint8_t CommandTask(SchedulerTask *Task)
+{
+	int16_t inByte;
+	
+	inByte = USBSerial_ReceiveByte();
+	while(inByte >= 0)
+	{
+		if((inByte > 0) && (inByte < 255))
 		{
-			//take data set
-			MinToWaitFor += MinToSkip;
-		
-		
-		
-		
-		
-		Datalogger_AddDataSet(DataBuffer);
-		*/
+			CommandGetInputChar(inByte);
+		}
+		inByte = USBSerial_ReceiveByte();
 	}
+	Commands_PollDataSet();
+	if(DataSetBusy() == 0)
+	{
+		RunCommand();
+	}
+	return SCHEDULER_TASK_WAITING;
+}
+
+/** Background work for the datalogger. Datalogger_Task only starts an erase when the dataflash is idle, so there is no need to check more than once per ms. */
+static uint8_t DataloggerTask(SchedulerTask *Task)
+{
+	SCHEDULER_TASK_BEGIN(Task);
+	while(1)
+	{
+		Datalogger_Task();
+		SCHEDULER_TASK_SLEEP(Task, 1);
+	}
+	SCHEDULER_TASK_END(Task);
 }
 
 /** Event handler for the library USB Connection event. */
@@ -128,10 +150,19 @@ void EVENT_USB_Device_ConfigurationChanged(void)
 	bool ConfigSuccess = true;
 
 	ConfigSuccess &= CDC_Device_ConfigureEndpoints(&VirtualSerial_CDC_Interface);
+	
+	//The CDC data endpoints are serviced every frame
+	USB_Device_EnableSOFEvents();
 
 	LEDs_SetAllLEDs(ConfigSuccess ? LEDMASK_USB_READY : LEDMASK_USB_ERROR);
 }
 
+/** Event handler for the library USB Start of Frame event. This runs every ms in the USB interrupt. */
+void EVENT_USB_Device_StartOfFrame(void)
+{
+	USBSerial_Service();
+}
+
 /** Event handler for the library USB Control Request reception event. */
 void EVENT_USB_Device_ControlRequest(void)
 {
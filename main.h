@@ -42,6 +42,8 @@
 		#include <avr/power.h>
 		#include <avr/interrupt.h>
 		#include <avr/eeprom.h>
+		#include <util/crc16.h>
+		#include <util/atomic.h>
 		#include <string.h>
 		#include <stdio.h>
 
@@ -60,12 +62,16 @@
 		
 		//Board includes
 		#include "Board/Hardware.h"
+		#include "Board/scheduler.h"
+		#include "Board/usbserial.h"
+		#include "Board/profile.h"
 		#include "Board/tcs3414.h"
 		#include "Board/sht25.h"
 		#include "Board/at45db321d.h"
 		#include "Board/mpl115a1.h"
 		
 		#include "Board/datalogger.h"
+		#include "Board/sampler.h"
 		
 	/* Macros: */
 		/** LED mask for the library LED driver, to indicate that the USB interface is not ready. */
@@ -91,6 +97,7 @@
 		void EVENT_USB_Device_Disconnect(void);
 		void EVENT_USB_Device_ConfigurationChanged(void);
 		void EVENT_USB_Device_ControlRequest(void);
+		void EVENT_USB_Device_StartOfFrame(void);
 
 #endif
 